@@ -12,36 +12,74 @@ AprxFairQueue::AprxFairQueue(linkspeed_bps bitrate, mem_b maxsize,
     _cfg = config;
 
     // Create the list of FIFO queues.
-    _packets = vector<list<Packet*> >(_cfg.nQueue, list<Packet*>());
+    _packets = vector<PacketArena::Fifo>(_cfg.nQueue);
+    _busy.resize(_cfg.nQueue);
 
     _Qsize = vector<uint32_t>(_cfg.nQueue, 0);
 
-    _sketch = vector<vector<uint64_t> >(_cfg.nHash, vector<uint64_t>(_cfg.nBucket, 0));
+    // Sketch rows are a power of 2 wide, so a hash maps to a cell by a shift.
+    _width = 2;
+    _shift = 63;
+    while (_width < _cfg.nBucket) {
+        _width <<= 1;
+        _shift--;
+    }
+    _cfg.nBucket = _width;
+
+    _sketch = vector<uint64_t>(_cfg.nHash * _width, 0);
+    _index = vector<uint32_t>(_cfg.nHash, 0);
+
+    // Fixed seeds keep runs reproducible without touching rand().
+    uint64_t seed = 0xAF0;
+    _hashA = vector<uint64_t>(_cfg.nHash);
+    _hashB = vector<uint64_t>(_cfg.nHash);
+    for (uint32_t i = 0; i < _cfg.nHash; i++) {
+        _hashA[i] = splitmix64(seed) | 1;
+        _hashB[i] = splitmix64(seed);
+    }
+
+    if (_cfg.sketch == AFQcfg::HEAVY_CACHE) {
+        uint32_t nHeavy = 2;
+        _heavyShift = 63;
+        while (nHeavy < _cfg.nHeavy) {
+            nHeavy <<= 1;
+            _heavyShift--;
+        }
+        _cfg.nHeavy = nHeavy;
+        _heavy = vector<HeavyEntry>(nHeavy);
+    }
 
     _nRounds = 0;
     _nPackets = 0;
 
     _currQ = 0;
 
-    _error = 0;
-    _count = 0;
-    _zero = 0;
+    _sampleThreshold = (uint32_t)min(_cfg.sampleRate * 4294967296.0, 4294967295.0);
+    _nSamples = 0;
+    _nPlaced = 0;
+    _nMisplaced = 0;
+    _nUnder = 0;
+    _sumOver = 0;
+    memset(_overHist, 0, sizeof(_overHist));
 }
 
 void
 AprxFairQueue::beginService()
 {
     if (_nPackets > 0) {
-        // We are guaranteed to hit a non-empty queue.
-        while (_packets[_currQ].empty()) {
-            _currQ++;
-            _nRounds++;
-            if (_currQ == _cfg.nQueue) {
-                _currQ = 0;
-            }
+        // We are guaranteed to hit a non-empty queue. Every queue skipped
+        // over, including wrapping around, is one round elapsed.
+        uint32_t nextQ = _busy.findNextCyclic(_currQ);
+        assert(nextQ != Bitmap::NONE);
+
+        if (nextQ >= _currQ) {
+            _nRounds += nextQ - _currQ;
+        } else {
+            _nRounds += nextQ + _cfg.nQueue - _currQ;
         }
+        _currQ = nextQ;
 
-        EventList::Get().sourceIsPendingRel(*this, drainTime(_packets[_currQ].back()));
+        EventList::Get().sourceIsPendingRel(*this, drainTime(_arena.front(_packets[_currQ])));
     }
 }
 
@@ -50,26 +88,25 @@ AprxFairQueue::completeService()
 {
     assert(_nPackets > 0);
 
-    Packet *pkt = _packets[_currQ].back();
-    _packets[_currQ].pop_back();
+    Packet *pkt = _arena.pop(_packets[_currQ]);
+    if (_packets[_currQ].count == 0) {
+        _busy.clear(_currQ);
+    }
     _Qsize[_currQ] -= pkt->size();
     _queuesize -= pkt->size();
     _nPackets -= 1;
 
     pkt->flow().logTraffic(*pkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*pkt, drainTime(pkt));
     if (_logger) {
         _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *pkt);
     }
 
-    uint64_t bytes = ULLONG_MAX;
-    for (unsigned int i = 0; i < _cfg.nHash; i++) {
-        uint64_t index = hashFlow(i, pkt->flow().id) % _cfg.nBucket;
-        bytes = min(_sketch[i][index], bytes);
-    }
+    uint64_t bytes = queryFlow(pkt->flow().id);
 
     uint64_t flowRound = bytes/_cfg.bytesPerRound;
     if (flowRound - _nRounds >= ECN_MARK_ROUND) {
-        pkt->setFlag(Packet::ECN_FWD);
+        _stats.mark(*pkt);
     }
 
     applyEcnMark(*pkt);
@@ -99,23 +136,21 @@ AprxFairQueue::receivePacket(Packet &pkt)
     bool queueWasEmpty = (_nPackets == 0);
 
     uint32_t flowid = pkt.flow().id;
-    uint64_t bytes = ULLONG_MAX;
 
     // Do first pass of sketch to find bytes transmitted by this flow.
-    for (unsigned int i = 0; i < _cfg.nHash; i++) {
-        uint64_t index = hashFlow(i, flowid) % _cfg.nBucket;
-        bytes = min(_sketch[i][index], bytes);
+    if (_cfg.sketch == AFQcfg::HEAVY_CACHE) {
+        voteHeavy(flowid);
     }
+    uint64_t bytes = queryFlow(flowid);
 
     // Figure out which FIFO queue to place this packet in.
-    uint64_t flowRound = bytes/_cfg.bytesPerRound;
-    uint32_t outQ = -1;
+    uint32_t outQ = pickQueue(bytes);
 
-    if (flowRound <= _nRounds) {
-        // Flow hasn't sent for quite a while.
-        bytes = max(_nRounds * _cfg.bytesPerRound, bytes);
-        outQ = _currQ;
-    } else if (flowRound - _nRounds >= _cfg.nQueue) {
+    if (_sampleThreshold > 0 && isSampled(flowid)) {
+        checkAccuracy(flowid, outQ, bytes, pkt.size());
+    }
+
+    if (outQ == _cfg.nQueue) {
         // Flow is sending too fast, packet too far in the future, DROP!
         if (TRACE_PKT == pkt.flow().id) {
             cout << str() <<  " DROP\n";
@@ -124,14 +159,11 @@ AprxFairQueue::receivePacket(Packet &pkt)
 
         // We shouldn't increment the sketch to reflect a dropped packet.
         return;
-    } else {
-        // We must have free space for this packet. Find which queue.
-        outQ = _currQ + (flowRound - _nRounds);
-        if (outQ >= _cfg.nQueue) {
-            outQ = outQ - _cfg.nQueue;
-        }
     }
 
+    // A flow that hasn't sent for quite a while starts from the current round.
+    bytes = max(_nRounds * _cfg.bytesPerRound, bytes);
+
     if (TRACE_PKT == pkt.flow().id) {
         cout << str() << " Pkt depart " << timeAsMs(EventList::Get().now()) << " flowid " << pkt.flow().id << " " << pkt.id() << endl;
         cout << str() << " " << outQ << " " << _currQ << endl;
@@ -139,38 +171,16 @@ AprxFairQueue::receivePacket(Packet &pkt)
 
     bytes += pkt.size();
 
-    // Exact bytes.
-    //if (_exactBytes.find(flowid) == _exactBytes.end()) {
-    //    _exactBytes[flowid] = _nRounds * _cfg.bytesPerRound + pkt.size();
-    //} else {
-    //    if (_exactBytes[flowid] > _nRounds * _cfg.bytesPerRound) {
-    //        _exactBytes[flowid] = _exactBytes[flowid] + pkt.size();
-    //    } else {
-    //        _exactBytes[flowid] = _nRounds * _cfg.bytesPerRound + pkt.size();
-    //    }
-    //}
-
-    //// Measure error.
-    //if (bytes == _exactBytes[flowid]) {
-    //    _zero++;
-    //} else if (bytes < _exactBytes[flowid]) {
-    //    _error += _exactBytes[flowid] - bytes;
-    //} else {
-    //    _error += bytes - _exactBytes[flowid];
-    //}
-    //_count++;
-
     // Enqueue it!
-    _packets[outQ].push_front(&pkt);
+    _arena.push(_packets[outQ], &pkt);
+    _busy.set(outQ);
     _Qsize[outQ] += pkt.size();
+    _stats.enqueue(pkt, _queuesize);
     _queuesize += pkt.size();
     _nPackets += 1;
 
     // Update the sketch to reflect new bytes.
-    for (unsigned int i = 0; i < _cfg.nHash; i++) {
-        uint64_t index = hashFlow(i, flowid) % _cfg.nBucket;
-        _sketch[i][index] = max(_sketch[i][index], bytes);
-    }
+    updateFlow(flowid, bytes, pkt.size());
 
     if (queueWasEmpty) {
         assert(_nPackets == 1);
@@ -178,67 +188,252 @@ AprxFairQueue::receivePacket(Packet &pkt)
     }
 }
 
+uint64_t
+AprxFairQueue::queryFlow(uint32_t flowid)
+{
+    if (_cfg.sketch == AFQcfg::HEAVY_CACHE) {
+        HeavyEntry &e = _heavy[(flowid * 0x9E3779B97F4A7C15ULL) >> _heavyShift];
+        if (e.flowid == flowid) {
+            return e.bytes;
+        }
+    }
+
+    hashFlow(flowid);
+    return sketchMin();
+}
+
 void
-AprxFairQueue::dropPacket(Packet &pkt)
+AprxFairQueue::updateFlow(uint32_t flowid, uint64_t bytes, mem_b size)
 {
-    if (_logger) {
-        _logger->logQueue(*this, QueueLogger::PKT_DROP, pkt);
+    switch (_cfg.sketch) {
+        case AFQcfg::COUNT_MIN: {
+            // Each counter restarts at the current round on its own.
+            uint64_t roundBytes = _nRounds * _cfg.bytesPerRound;
+            for (uint32_t i = 0; i < _cfg.nHash; i++) {
+                _sketch[_index[i]] = max(_sketch[_index[i]], roundBytes) + size;
+            }
+            break;
+        }
+
+        case AFQcfg::HEAVY_CACHE: {
+            HeavyEntry &e = _heavy[(flowid * 0x9E3779B97F4A7C15ULL) >> _heavyShift];
+            if (e.flowid == flowid) {
+                e.bytes = bytes;
+                break;
+            }
+            sketchUpdate(bytes);
+            break;
+        }
+
+        default:
+            sketchUpdate(bytes);
     }
-    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
-    pkt.free();
 }
 
-uint64_t
-AprxFairQueue::hashFlow(int index, uint32_t flowid)
+void
+AprxFairQueue::voteHeavy(uint32_t flowid)
 {
-    /* A lame hash function impersonator, multiplies by a large prime number. */
+    HeavyEntry &e = _heavy[(flowid * 0x9E3779B97F4A7C15ULL) >> _heavyShift];
 
-    uint64_t prime;
+    if (e.flowid == flowid) {
+        e.votePos++;
+        return;
+    }
 
-    switch (index) {
-        case 0:
-            prime = 7643;   // 970th prime number.
-            break;
+    if (e.flowid != FlowTable<uint64_t>::EMPTY) {
+        e.voteNeg++;
+        if (e.voteNeg < AFQ_HEAVY_LAMBDA * e.votePos) {
+            return;
+        }
 
-        case 1:
-            prime = 7723;   // 980th prime number.
-            break;
+        // Resident lost the vote, push its bytes down into the sketch.
+        hashFlow(e.flowid);
+        sketchUpdate(e.bytes);
+    }
 
-        case 2:
-            prime = 7829;   // 990th prime number.
-            break;
+    // Take over the entry, starting from what the sketch knows of the flow.
+    hashFlow(flowid);
+    e.flowid = flowid;
+    e.bytes = sketchMin();
+    e.votePos = 1;
+    e.voteNeg = 0;
+}
 
-        case 3:
-            prime = 7919;   // 1000th prime number.
-            break;
+uint64_t
+AprxFairQueue::sketchMemory()
+{
+    return _sketch.size() * sizeof(uint64_t) + _heavy.size() * sizeof(HeavyEntry);
+}
 
+const char*
+AprxFairQueue::sketchName()
+{
+    switch (_cfg.sketch) {
+        case AFQcfg::COUNT_MIN:
+            return "cm";
+        case AFQcfg::HEAVY_CACHE:
+            return "hh";
         default:
-            prime = 1;
+            return "cu";
     }
+}
 
-    return prime * flowid;
+uint32_t
+AprxFairQueue::pickQueue(uint64_t bytes)
+{
+    uint64_t flowRound = bytes/_cfg.bytesPerRound;
+
+    if (flowRound <= _nRounds) {
+        // Flow hasn't sent for quite a while.
+        return _currQ;
+    } else if (flowRound - _nRounds >= _cfg.nQueue) {
+        // Packet too far in the future.
+        return _cfg.nQueue;
+    }
+
+    // We must have free space for this packet. Find which queue.
+    uint32_t outQ = _currQ + (flowRound - _nRounds);
+    if (outQ >= _cfg.nQueue) {
+        outQ = outQ - _cfg.nQueue;
+    }
+    return outQ;
+}
+
+bool
+AprxFairQueue::isSampled(uint32_t flowid)
+{
+    // Sample on a hash of the flow id, so a flow is either always or never tracked.
+    return (uint32_t)((flowid * 0xD6E8FEB86659FD93ULL) >> 32) < _sampleThreshold;
 }
 
 void
-AprxFairQueue::printStats()
+AprxFairQueue::checkAccuracy(uint32_t flowid, uint32_t outQ, uint64_t bytes, mem_b size)
 {
-    unordered_map<uint32_t, uint32_t> counts;
+    uint64_t roundBytes = _nRounds * _cfg.bytesPerRound;
+    uint64_t *exact = _exactBytes.find(flowid);
+    uint64_t exactBytes = (exact != NULL) ? *exact : 0;
+
+    // Where the packet would have gone with exact per-flow state.
+    _nPlaced++;
+    if (pickQueue(exactBytes) != outQ) {
+        _nMisplaced++;
+    }
 
-    for (uint32_t i = 0; i < _cfg.nQueue; i++) {
-        for (auto const &i : _packets[i]) {
-            uint32_t fid = i->flow().id;
-            if (counts.find(fid) == counts.end()) {
-                counts[fid] = 0;
+    // Dropped packets don't count towards the flow's bytes.
+    if (outQ == _cfg.nQueue) {
+        return;
+    }
+
+    exactBytes = max(roundBytes, exactBytes) + size;
+    bytes = max(roundBytes, bytes) + size;
+
+    if (bytes < exactBytes) {
+        _nUnder++;
+    } else {
+        uint64_t over = bytes - exactBytes;
+        uint32_t bin = 0;
+        while (over >> bin && bin < AFQ_ERROR_BINS - 1) {
+            bin++;
+        }
+        _overHist[bin]++;
+        _sumOver += over;
+    }
+    _nSamples++;
+
+    if (exact != NULL) {
+        *exact = exactBytes;
+    } else {
+        _exactBytes[flowid] = exactBytes;
+    }
+
+    // Flows that fell behind the current round are treated as new flows,
+    // so they can be forgotten without changing the measurement.
+    if (_exactBytes.size() > 1024 && (_nSamples & 4095) == 0) {
+        std::vector<uint32_t> stale;
+        _exactBytes.forEach([&](uint32_t fid, uint64_t &b) {
+            if (b <= roundBytes) {
+                stale.push_back(fid);
             }
-            counts[fid] = counts[fid] + 1;
+        });
+        for (auto fid : stale) {
+            _exactBytes.erase(fid);
         }
     }
+}
 
-    cout << str() << " " << timeAsMs(EventList::Get().now()) << " stats";
-    for (auto it = counts.begin(); it != counts.end(); it++) {
-        cout << " " << it->first << "->" << it->second;
+void
+AprxFairQueue::printAccuracy()
+{
+    // Upper bound (in bytes) of the bin holding the given percentile.
+    auto percentile = [&](double p) -> uint64_t {
+        uint64_t target = (uint64_t)ceil(p * _nSamples);
+        uint64_t cumul = 0;
+        for (uint32_t i = 0; i < AFQ_ERROR_BINS; i++) {
+            cumul += _overHist[i];
+            if (cumul >= target) {
+                return (i == 0) ? 0 : (1ULL << i) - 1;
+            }
+        }
+        return ULLONG_MAX;
+    };
+
+    printStatsPrefix();
+    cout << " afq-accuracy"
+         << " samples " << _nSamples
+         << " exact " << _overHist[0]
+         << " under " << _nUnder
+         << " meanOver " << (_nSamples ? (double)_sumOver / _nSamples : 0.0)
+         << " p50 " << percentile(0.5)
+         << " p90 " << percentile(0.9)
+         << " p99 " << percentile(0.99)
+         << " misplaced " << _nMisplaced << " " << _nPlaced
+         << " tracked " << _exactBytes.size()
+         << " sketch " << sketchName() << " mem " << sketchMemory() << endl;
+}
+
+void
+AprxFairQueue::hashFlow(uint32_t flowid)
+{
+    /* Multiply-add-shift (Dietzfelbinger), pairwise independent for 32-bit keys.
+     * Branch-free over all rows at once, so the compiler can vectorize it. */
+    const uint64_t *a = _hashA.data();
+    const uint64_t *b = _hashB.data();
+    uint32_t *index = _index.data();
+    uint64_t key = flowid;
+
+    for (uint32_t i = 0; i < _cfg.nHash; i++) {
+        index[i] = i * _width + (uint32_t)((a[i] * key + b[i]) >> _shift);
+    }
+}
+
+uint64_t
+AprxFairQueue::sketchMin()
+{
+    const uint64_t *sketch = _sketch.data();
+    uint64_t bytes = ULLONG_MAX;
+
+    for (uint32_t i = 0; i < _cfg.nHash; i++) {
+        bytes = min(sketch[_index[i]], bytes);
     }
-    cout << endl;
+    return bytes;
+}
 
-    //cout << "AFQ: " << _error << " " << _count << " " << _zero << endl;
+void
+AprxFairQueue::sketchUpdate(uint64_t bytes)
+{
+    uint64_t *sketch = _sketch.data();
+
+    for (uint32_t i = 0; i < _cfg.nHash; i++) {
+        sketch[_index[i]] = max(sketch[_index[i]], bytes);
+    }
+}
+
+void
+AprxFairQueue::printStats()
+{
+    Queue::printStats();
+
+    if (_sampleThreshold > 0) {
+        printAccuracy();
+    }
 }
@@ -6,18 +6,38 @@
  */
 
 #include "queue.h"
+#include "bitmap.h"
+#include "packetarena.h"
+#include "flowtable.h"
 
 #define ECN_MARK_ROUND 8
 
+// Log2 bins of the sketch over-estimation histogram, in bytes.
+#define AFQ_ERROR_BINS 48
+
+// Negative to positive vote ratio that evicts a heavy-hitter cache entry.
+#define AFQ_HEAVY_LAMBDA 8
+
 struct AFQcfg {
+    // Structures available to estimate per-flow bytes.
+    enum Sketch {
+        COUNT_MIN,    // Count-min, every counter advanced independently.
+        CONSERVATIVE, // Count-min, counters only raised to the new minimum.
+        HEAVY_CACHE   // Exact heavy-hitter cache in front of a conservative count-min.
+    };
+
     // Default values.
-    AFQcfg() : nHash(2), nBucket(1024), nQueue(32), bytesPerRound(MSS_BYTES), alpha(8) {}
+    AFQcfg() : nHash(2), nBucket(1024), nQueue(32), bytesPerRound(MSS_BYTES), alpha(8),
+               sampleRate(0.0), sketch(CONSERVATIVE), nHeavy(64) {}
 
     uint32_t nHash;         // Rows in the count-min sketch.
-    uint32_t nBucket;       // Columns in the count-min sketch.
+    uint32_t nBucket;       // Columns in the count-min sketch (rounded up to a power of 2).
     uint32_t nQueue;        // Number of available FIFO queues. 
     uint32_t bytesPerRound; // Bytes of a flow to be enqueued in a queue.
     uint32_t alpha;         // Coefficient for dymanic buffer sharing.
+    double sampleRate;      // Fraction of flows tracked exactly to measure sketch accuracy.
+    Sketch sketch;          // Per-flow bytes estimator.
+    uint32_t nHeavy;        // Heavy-hitter cache entries (rounded up to a power of 2).
 };
 
 class AprxFairQueue : public Queue
@@ -28,19 +48,74 @@ public:
     void receivePacket(Packet &pkt);
     void printStats();
 
+    // Bytes of state held by the per-flow estimator.
+    uint64_t sketchMemory();
+    const char* sketchName();
+
 protected:
     void beginService();
     void completeService();
-    void dropPacket(Packet &pkt);
 
 private:
-    uint64_t hashFlow(int index, uint32_t flowid);
+    // Computes the sketch cell of this flow in every row into _index.
+    void hashFlow(uint32_t flowid);
+
+    // Minimum over the cells in _index.
+    uint64_t sketchMin();
+
+    // Raises the cells in _index to at least bytes.
+    void sketchUpdate(uint64_t bytes);
+
+    // Estimated bytes sent by a flow. Leaves _index set for the flow
+    // unless it is held in the heavy-hitter cache.
+    uint64_t queryFlow(uint32_t flowid);
+
+    // Records that a flow has now sent bytes, the last size of which just
+    // arrived. Must follow queryFlow() on the same flow.
+    void updateFlow(uint32_t flowid, uint64_t bytes, mem_b size);
+
+    // Votes for the heavy-hitter cache entry of an arriving flow, possibly
+    // evicting the resident flow into the sketch.
+    void voteHeavy(uint32_t flowid);
+
+    // FIFO queue for a flow that has sent bytes so far, or _cfg.nQueue to drop.
+    uint32_t pickQueue(uint64_t bytes);
+
+    // Compares the sketch against exact bytes for sampled flows.
+    bool isSampled(uint32_t flowid);
+    void checkAccuracy(uint32_t flowid, uint32_t outQ, uint64_t bytes, mem_b size);
+    void printAccuracy();
+
+    // Multiple queues storing all the packets, backed by a shared node pool.
+    PacketArena _arena;
+    std::vector<PacketArena::Fifo> _packets;
 
-    // Multiple queues storing all the packets.
-    std::vector<std::list<Packet*> > _packets;
+    // Which FIFO queues hold packets.
+    Bitmap _busy;
 
     // Count-min sketch to store bytes transmitted by a flow.
-    std::vector<std::vector<uint64_t> > _sketch;
+    // Row-major, nHash rows of _width cells each.
+    std::vector<uint64_t> _sketch;
+    uint32_t _width;
+    uint32_t _shift;
+
+    // Multiply-add-shift hash family, one (a, b) pair per row.
+    std::vector<uint64_t> _hashA;
+    std::vector<uint64_t> _hashB;
+
+    // Sketch cells of the flow being processed, one per row.
+    std::vector<uint32_t> _index;
+
+    // Heavy-hitter cache, direct-mapped by flow id (elastic sketch heavy part).
+    struct HeavyEntry {
+        HeavyEntry() : flowid(FlowTable<uint64_t>::EMPTY), votePos(0), voteNeg(0), bytes(0) {}
+        uint32_t flowid;
+        uint32_t votePos;
+        uint32_t voteNeg;
+        uint64_t bytes;
+    };
+    std::vector<HeavyEntry> _heavy;
+    uint32_t _heavyShift;
 
     // Bytes stored in each FIFO queue.
     std::vector<uint32_t> _Qsize;
@@ -58,10 +133,15 @@ private:
     // Number of packets currently enqueued.
     uint64_t _nPackets;
 
-    std::unordered_map<uint32_t, uint64_t> _exactBytes;
-    uint64_t _error;
-    uint64_t _count;
-    uint64_t _zero;
+    // Accuracy monitor, exact bytes of the sampled flows.
+    FlowTable<uint64_t> _exactBytes;
+    uint32_t _sampleThreshold;  // Flows hashing below this are sampled.
+    uint64_t _nSamples;         // Sampled packets enqueued.
+    uint64_t _nPlaced;          // Sampled packets placed (or dropped) by the sketch.
+    uint64_t _nMisplaced;       // ... in a different queue than exact bytes would.
+    uint64_t _nUnder;           // Sampled packets the sketch under-estimated.
+    uint64_t _sumOver;          // Total over-estimation in bytes.
+    uint64_t _overHist[AFQ_ERROR_BINS];
 };
 
 #endif
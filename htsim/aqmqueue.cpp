@@ -0,0 +1,375 @@
+#include "aqmqueue.h"
+#include "logfile.h"
+#include "test.h"
+
+#define TRACE_PKT 0 && 4304
+
+using namespace std;
+
+void
+parseAqmArgs(const ArgList &args,
+             AQMcfg &cfg)
+{
+    uint32_t AqmEcn = cfg.ecn;
+    double CodelTarget = timeAsUs(cfg.codelTarget);
+    double CodelInterval = timeAsUs(cfg.codelInterval);
+    double PieTarget = timeAsUs(cfg.pieTarget);
+    double PieUpdate = timeAsUs(cfg.pieUpdate);
+    parseInt(args, "aqmEcn", AqmEcn);
+    parseLongInt(args, "redMin", cfg.redMinTh);
+    parseLongInt(args, "redMax", cfg.redMaxTh);
+    parseDouble(args, "redP", cfg.redMaxP);
+    parseDouble(args, "redWeight", cfg.redWeight);
+    parseDouble(args, "codelTarget", CodelTarget);
+    parseDouble(args, "codelInterval", CodelInterval);
+    parseDouble(args, "pieTarget", PieTarget);
+    parseDouble(args, "pieUpdate", PieUpdate);
+    cfg.ecn = (AqmEcn != 0);
+    cfg.codelTarget = timeFromUs(CodelTarget);
+    cfg.codelInterval = timeFromUs(CodelInterval);
+    cfg.pieTarget = timeFromUs(PieTarget);
+    cfg.pieUpdate = timeFromUs(PieUpdate);
+}
+
+AqmQueue::AqmQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct AQMcfg config)
+    : Queue(bitrate, maxsize, logger), _cfg(config), _currentPkt(NULL),
+      _idleSince(0), _nMarks(0), _nEarlyDrops(0)
+{
+}
+
+bool
+AqmQueue::signal(Packet &pkt, bool queued, bool mayMark)
+{
+    if (_cfg.ecn && mayMark) {
+        _stats.mark(pkt);
+        _nMarks++;
+        return false;
+    }
+
+    if (queued) {
+        _queuesize -= pkt.size();
+        _stats.evict(pkt);
+    }
+    _nEarlyDrops++;
+    dropPacket(pkt);
+    return true;
+}
+
+Packet*
+AqmQueue::pop(simtime_picosec &sojourn)
+{
+    Entry e = _fifo.front();
+    _fifo.pop_front();
+    sojourn = EventList::Get().now() - e.ts;
+    return e.pkt;
+}
+
+Packet*
+AqmQueue::dequeue()
+{
+    if (_fifo.empty()) {
+        return NULL;
+    }
+    simtime_picosec sojourn;
+    return pop(sojourn);
+}
+
+void
+AqmQueue::beginService()
+{
+    _currentPkt = dequeue();
+
+    if (_currentPkt != NULL) {
+        // Schedule it's completion time.
+        EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+
+        if (TRACE_PKT == _currentPkt->flow().id) {
+            cout << str() << " Pkt depart sched " << EventList::Get().now() << " "
+                 << _currentPkt->id() << " " << _fifo.size() << endl;
+        }
+    } else {
+        _idleSince = EventList::Get().now();
+    }
+}
+
+void
+AqmQueue::completeService()
+{
+    // Logging and cleanup.
+    _currentPkt->flow().logTraffic(*_currentPkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*_currentPkt, drainTime(_currentPkt));
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *_currentPkt);
+    }
+
+    _currentPkt->sendOn();
+
+    // Clear packet being transmitted.
+    _queuesize -= _currentPkt->size();
+    _currentPkt = NULL;
+
+    beginService();
+}
+
+void
+AqmQueue::receivePacket(Packet &pkt)
+{
+    // If there is no space in the buffer, return immediately.
+    if (_queuesize + pkt.size() > _maxsize) {
+        dropPacket(pkt);
+        return;
+    }
+
+    // Early signal, a dropped packet never enters the queue.
+    if (!admit(pkt)) {
+        return;
+    }
+
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
+    bool queueWasEmpty = (_currentPkt == NULL) && _fifo.empty();
+
+    Entry e = {&pkt, EventList::Get().now()};
+    _fifo.push_back(e);
+    _stats.enqueue(pkt, _queuesize);
+    _queuesize += pkt.size();
+
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    }
+
+    if (queueWasEmpty) {
+        beginService();
+    }
+}
+
+void
+AqmQueue::printStats()
+{
+    Queue::printStats();
+
+    if (_nMarks > 0 || _nEarlyDrops > 0) {
+        printStatsPrefix();
+        cout << " aqm " << aqmName() << " marks " << _nMarks << " drops " << _nEarlyDrops << endl;
+    }
+}
+
+RedQueue::RedQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct AQMcfg config)
+    : AqmQueue(bitrate, maxsize, logger, config), _avg(0), _count(-1)
+{
+    if (_cfg.redMinTh == 0) {
+        _cfg.redMinTh = dctcpThreshold();
+    }
+    if (_cfg.redMaxTh == 0) {
+        _cfg.redMaxTh = 3 * _cfg.redMinTh;
+    }
+    assert(_cfg.redMaxTh > _cfg.redMinTh);
+}
+
+bool
+RedQueue::admit(Packet &pkt)
+{
+    double w = _cfg.redWeight;
+
+    if (_currentPkt == NULL && _fifo.empty()) {
+        // Decay the average as if small packets had been sent while idle.
+        double m = (double)(EventList::Get().now() - _idleSince) / (MSS_BYTES * _ps_per_byte);
+        _avg *= pow(1 - w, m);
+    } else {
+        _avg = (1 - w) * _avg + w * _queuesize;
+    }
+
+    if (_avg < _cfg.redMinTh) {
+        _count = -1;
+        return true;
+    }
+    if (_avg >= _cfg.redMaxTh) {
+        _count = 0;
+        return !signal(pkt, false);
+    }
+
+    // Spread signals out evenly by counting packets since the last one.
+    _count++;
+    double pb = _cfg.redMaxP * (_avg - _cfg.redMinTh) / (_cfg.redMaxTh - _cfg.redMinTh);
+    double pa = (_count * pb < 1) ? pb / (1 - _count * pb) : 1;
+
+    if (drand() < pa) {
+        _count = 0;
+        return !signal(pkt, false);
+    }
+    return true;
+}
+
+CodelQueue::CodelQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct AQMcfg config)
+    : AqmQueue(bitrate, maxsize, logger, config), _firstAboveTime(0), _dropNext(0),
+      _count(0), _lastCount(0), _dropping(false)
+{
+}
+
+simtime_picosec
+CodelQueue::controlLaw(simtime_picosec t)
+{
+    return t + (simtime_picosec)(_cfg.codelInterval / sqrt((double)_count));
+}
+
+Packet*
+CodelQueue::doDequeue(bool &okToDrop)
+{
+    okToDrop = false;
+    if (_fifo.empty()) {
+        _firstAboveTime = 0;
+        return NULL;
+    }
+
+    simtime_picosec now = EventList::Get().now();
+    simtime_picosec sojourn;
+    Packet *pkt = pop(sojourn);
+
+    if (sojourn < _cfg.codelTarget || _queuesize - pkt->size() <= MSS_BYTES) {
+        // Went below target, or too little left to keep a queue standing.
+        _firstAboveTime = 0;
+    } else if (_firstAboveTime == 0) {
+        _firstAboveTime = now + _cfg.codelInterval;
+    } else if (now >= _firstAboveTime) {
+        okToDrop = true;
+    }
+    return pkt;
+}
+
+Packet*
+CodelQueue::dequeue()
+{
+    simtime_picosec now = EventList::Get().now();
+    bool okToDrop;
+    Packet *pkt = doDequeue(okToDrop);
+
+    if (pkt == NULL) {
+        _dropping = false;
+        return NULL;
+    }
+
+    if (_dropping) {
+        if (!okToDrop) {
+            _dropping = false;
+        }
+
+        // Signal at the control law rate while the delay stays high.
+        while (_dropping && now >= _dropNext) {
+            _count++;
+            if (!signal(*pkt, true)) {
+                _dropNext = controlLaw(_dropNext);
+                break;
+            }
+
+            pkt = doDequeue(okToDrop);
+            if (pkt == NULL) {
+                _dropping = false;
+            } else if (!okToDrop) {
+                _dropping = false;
+            } else {
+                _dropNext = controlLaw(_dropNext);
+            }
+        }
+    } else if (okToDrop) {
+        if (signal(*pkt, true)) {
+            pkt = doDequeue(okToDrop);
+        }
+        _dropping = true;
+
+        // Resume near the last signal rate if we were dropping recently.
+        uint32_t delta = _count - _lastCount;
+        _count = 1;
+        if (delta > 1 && (now < _dropNext || now - _dropNext < 16 * _cfg.codelInterval)) {
+            _count = delta;
+        }
+        _dropNext = controlLaw(now);
+        _lastCount = _count;
+    }
+
+    return pkt;
+}
+
+PieQueue::PieQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct AQMcfg config)
+    : AqmQueue(bitrate, maxsize, logger, config), _prob(0), _qdelayOld(0),
+      _burstAllowance(0), _nextUpdate(0)
+{
+    assert(_cfg.pieTarget > 0 && _cfg.pieUpdate > 0);
+}
+
+void
+PieQueue::update()
+{
+    // Updates run lazily on arrival, catching up on the periods since the last.
+    simtime_picosec now = EventList::Get().now();
+    double scale = timeAsSec(timeFromMs(15)) / timeAsSec(_cfg.pieTarget);
+    simtime_picosec maxBurst = 10 * _cfg.pieTarget;
+
+    for (uint32_t n = 0; now >= _nextUpdate && n < 100; n++) {
+        simtime_picosec qdelay = _queuesize * _ps_per_byte;
+
+        double delta = _cfg.pieAlpha * (timeAsSec(qdelay) - timeAsSec(_cfg.pieTarget))
+                     + _cfg.pieBeta * (timeAsSec(qdelay) - timeAsSec(_qdelayOld));
+        delta *= scale;
+
+        // Small probabilities move in small steps.
+        if (_prob < 0.000001) {
+            delta /= 2048;
+        } else if (_prob < 0.00001) {
+            delta /= 512;
+        } else if (_prob < 0.0001) {
+            delta /= 128;
+        } else if (_prob < 0.001) {
+            delta /= 32;
+        } else if (_prob < 0.01) {
+            delta /= 8;
+        } else if (_prob < 0.1) {
+            delta /= 2;
+        } else if (delta > 0.02) {
+            delta = 0.02;
+        }
+
+        _prob += delta;
+        if (qdelay == 0 && _qdelayOld == 0) {
+            _prob *= 0.98;
+        }
+        _prob = min(max(_prob, 0.0), 1.0);
+
+        _burstAllowance = (_burstAllowance > _cfg.pieUpdate) ? _burstAllowance - _cfg.pieUpdate : 0;
+        if (_prob == 0 && qdelay < _cfg.pieTarget / 2 && _qdelayOld < _cfg.pieTarget / 2) {
+            _burstAllowance = maxBurst;
+        }
+
+        _qdelayOld = qdelay;
+        _nextUpdate += _cfg.pieUpdate;
+    }
+
+    if (now >= _nextUpdate) {
+        _nextUpdate = now + _cfg.pieUpdate;
+    }
+}
+
+bool
+PieQueue::admit(Packet &pkt)
+{
+    update();
+
+    // Let bursts and short queues through.
+    if (_burstAllowance > 0) {
+        return true;
+    }
+    if (_qdelayOld < _cfg.pieTarget / 2 && _prob < 0.2) {
+        return true;
+    }
+    if (_queuesize <= 2 * MSS_BYTES) {
+        return true;
+    }
+
+    // Past 10% marking no longer keeps up, drop even with ECN.
+    if (drand() < _prob) {
+        return !signal(pkt, false, _prob <= 0.1);
+    }
+    return true;
+}
@@ -0,0 +1,167 @@
+#ifndef AQM_QUEUE_H
+#define AQM_QUEUE_H
+
+/*
+ * Active queue management: RED, CoDel and PIE.
+ *
+ * Each is a FIFO that signals congestion early, either by setting ECN on
+ * the packet or by dropping it. Packets are timestamped on enqueue so
+ * their sojourn time is known on dequeue. AQM queues do not apply the
+ * fixed DCTCP marking threshold of the base Queue.
+ */
+
+#include "queue.h"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+struct AQMcfg {
+    // Default values, scaled for datacenter round-trip times.
+    AQMcfg() : ecn(true),
+               redMinTh(0), redMaxTh(0), redMaxP(0.1), redWeight(0.002),
+               codelTarget(timeFromUs(10)), codelInterval(timeFromUs(100)),
+               pieTarget(timeFromUs(20)), pieUpdate(timeFromUs(20)),
+               pieAlpha(0.125), pieBeta(1.25) {}
+
+    bool ecn;                       // Mark ECN instead of dropping.
+
+    // RED, thresholds on the average queue in bytes, 0 derives them from
+    // the DCTCP threshold of the link speed.
+    mem_b redMinTh;
+    mem_b redMaxTh;
+    double redMaxP;                 // Signal probability at the max threshold.
+    double redWeight;               // Weight of the average queue EWMA.
+
+    // CoDel.
+    simtime_picosec codelTarget;    // Acceptable standing sojourn time.
+    simtime_picosec codelInterval;  // Time above target before signalling.
+
+    // PIE, gains are the RFC 8033 values for its 15ms target and are
+    // scaled to pieTarget.
+    simtime_picosec pieTarget;      // Target queueing delay.
+    simtime_picosec pieUpdate;      // Probability update period.
+    double pieAlpha;
+    double pieBeta;
+};
+
+// Reads --aqmEcn, the RED thresholds and weights, and the CoDel and PIE
+// times in microsec from an experiment's arguments into cfg.
+void parseAqmArgs(const std::unordered_map<std::string, std::string> &args, AQMcfg &cfg);
+
+class AqmQueue : public Queue
+{
+public:
+    AqmQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct AQMcfg config);
+    void receivePacket(Packet &pkt);
+    void printStats();
+
+protected:
+    void beginService();
+    void completeService();
+
+    // Early congestion signal for a packet, returns true if it was dropped.
+    bool signal(Packet &pkt, bool queued, bool mayMark = true);
+
+    // Early signal for an arriving packet, returns false if it was dropped.
+    virtual bool admit(Packet &pkt) = 0;
+
+    // Next packet to transmit, may signal or drop packets from the head.
+    virtual Packet* dequeue();
+
+    // Removes the head packet, returning its sojourn time.
+    Packet* pop(simtime_picosec &sojourn);
+
+    virtual const char* aqmName() = 0;
+
+    struct AQMcfg _cfg;
+
+    // Packets with their enqueue time.
+    struct Entry {
+        Packet *pkt;
+        simtime_picosec ts;
+    };
+    std::deque<Entry> _fifo;
+
+    // Current packet being serviced.
+    Packet *_currentPkt;
+
+    simtime_picosec _idleSince;     // Time the queue last went empty.
+    uint64_t _nMarks;
+    uint64_t _nEarlyDrops;
+};
+
+/*
+ * Random early detection, signals with a probability that grows with the
+ * average queue size between the two thresholds, and always above.
+ */
+class RedQueue : public AqmQueue
+{
+public:
+    RedQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct AQMcfg config = AQMcfg());
+
+protected:
+    bool admit(Packet &pkt);
+    const char* aqmName() { return "red"; }
+
+private:
+    double _avg;                    // Average queue size in bytes.
+    int64_t _count;                 // Packets since the last signal, -1 below minTh.
+};
+
+/*
+ * Controlled delay (RFC 8289), signals on dequeue once the sojourn time
+ * has stayed above target for an interval, at a rate that grows with the
+ * square root of the number of signals.
+ */
+class CodelQueue : public AqmQueue
+{
+public:
+    CodelQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct AQMcfg config = AQMcfg());
+
+protected:
+    bool admit(Packet &) { return true; }
+    Packet* dequeue();
+    const char* aqmName() { return "codel"; }
+
+private:
+    // Pops the head packet and updates whether it is ok to signal.
+    Packet* doDequeue(bool &okToDrop);
+    simtime_picosec controlLaw(simtime_picosec t);
+
+    simtime_picosec _firstAboveTime;
+    simtime_picosec _dropNext;
+    uint32_t _count;
+    uint32_t _lastCount;
+    bool _dropping;
+};
+
+/*
+ * Proportional integral controller enhanced (RFC 8033), signals arriving
+ * packets with a probability updated periodically from the queueing delay
+ * and its trend. The delay is the drain time of the backlog.
+ */
+class PieQueue : public AqmQueue
+{
+public:
+    PieQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct AQMcfg config = AQMcfg());
+
+protected:
+    bool admit(Packet &pkt);
+    const char* aqmName() { return "pie"; }
+
+private:
+    // Runs the probability updates due by now.
+    void update();
+
+    double _prob;                       // Signal probability.
+    simtime_picosec _qdelayOld;         // Delay at the previous update.
+    simtime_picosec _burstAllowance;    // Time left to let bursts through.
+    simtime_picosec _nextUpdate;
+};
+
+#endif
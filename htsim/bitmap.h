@@ -0,0 +1,164 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+/*
+ * A fixed-size bitmap with fast search for the next set bit, used to keep
+ * track of which of a set of queues are occupied.
+ */
+
+#include "htsim.h"
+
+#include <vector>
+
+class Bitmap
+{
+public:
+    static const uint32_t NONE = 0xffffffff;
+
+    Bitmap(uint32_t nBits = 0) { resize(nBits); }
+
+    void resize(uint32_t nBits)
+    {
+        _nBits = nBits;
+        _words.assign((nBits + 63) / 64, 0);
+        _count = 0;
+    }
+
+    inline void set(uint32_t i)
+    {
+        uint64_t bit = 1ULL << (i & 63);
+        if (!(_words[i >> 6] & bit)) {
+            _words[i >> 6] |= bit;
+            _count++;
+        }
+    }
+
+    inline void clear(uint32_t i)
+    {
+        uint64_t bit = 1ULL << (i & 63);
+        if (_words[i >> 6] & bit) {
+            _words[i >> 6] &= ~bit;
+            _count--;
+        }
+    }
+
+    inline bool test(uint32_t i) const
+    {
+        return (_words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    inline bool any() const { return _count > 0; }
+    inline uint32_t count() const { return _count; }
+    inline uint32_t size() const { return _nBits; }
+
+    // First set bit at or after i, or NONE.
+    inline uint32_t findNext(uint32_t i) const
+    {
+        if (i >= _nBits) {
+            return NONE;
+        }
+
+        uint32_t w = i >> 6;
+        uint64_t word = _words[w] & (~0ULL << (i & 63));
+
+        while (true) {
+            if (word != 0) {
+                uint32_t bit = (w << 6) + __builtin_ctzll(word);
+                return bit < _nBits ? bit : NONE;
+            }
+            if (++w == _words.size()) {
+                return NONE;
+            }
+            word = _words[w];
+        }
+    }
+
+    // Last set bit at or before i, or NONE.
+    inline uint32_t findPrev(uint32_t i) const
+    {
+        if (_nBits == 0) {
+            return NONE;
+        }
+        if (i >= _nBits) {
+            i = _nBits - 1;
+        }
+
+        uint32_t w = i >> 6;
+        uint64_t word = _words[w] & (~0ULL >> (63 - (i & 63)));
+
+        while (true) {
+            if (word != 0) {
+                return (w << 6) + 63 - __builtin_clzll(word);
+            }
+            if (w-- == 0) {
+                return NONE;
+            }
+            word = _words[w];
+        }
+    }
+
+    // Last set bit at or before i, wrapping around the start, or NONE.
+    inline uint32_t findPrevCyclic(uint32_t i) const
+    {
+        if (_count == 0) {
+            return NONE;
+        }
+        uint32_t bit = findPrev(i);
+        if (bit == NONE) {
+            bit = findPrev(_nBits - 1);
+        }
+        return bit;
+    }
+
+    // First set bit at or after i, wrapping around the end, or NONE.
+    inline uint32_t findNextCyclic(uint32_t i) const
+    {
+        if (_count == 0) {
+            return NONE;
+        }
+        uint32_t bit = findNext(i);
+        if (bit == NONE) {
+            bit = findNext(0);
+        }
+        return bit;
+    }
+
+    // First bit set here and in mask at or after i, wrapping around the end,
+    // or NONE. The mask must have the same size.
+    inline uint32_t findNextCyclic(uint32_t i, const Bitmap &mask) const
+    {
+        uint32_t bit = findNextAnd(i, mask);
+        if (bit == NONE && i > 0) {
+            bit = findNextAnd(0, mask);
+        }
+        return bit;
+    }
+
+private:
+    inline uint32_t findNextAnd(uint32_t i, const Bitmap &mask) const
+    {
+        if (i >= _nBits) {
+            return NONE;
+        }
+
+        uint32_t w = i >> 6;
+        uint64_t word = _words[w] & mask._words[w] & (~0ULL << (i & 63));
+
+        while (true) {
+            if (word != 0) {
+                uint32_t bit = (w << 6) + __builtin_ctzll(word);
+                return bit < _nBits ? bit : NONE;
+            }
+            if (++w == _words.size()) {
+                return NONE;
+            }
+            word = _words[w] & mask._words[w];
+        }
+    }
+
+    std::vector<uint64_t> _words;
+    uint32_t _nBits;
+    uint32_t _count;
+};
+
+#endif /* BITMAP_H */
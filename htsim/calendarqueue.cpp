@@ -0,0 +1,143 @@
+#include "calendarqueue.h"
+
+#define TRACE_PKT 0 && 4304
+
+using namespace std;
+
+CalendarQueue::CalendarQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct CQcfg config)
+    : Queue(bitrate, maxsize, logger), _cfg(config), _arena(maxsize / MSS_BYTES),
+      _currSlot(0), _currStart(0), _nPackets(0), _nOverflow(0), _currentPkt(NULL)
+{
+    assert(_cfg.nSlots > 0 && _cfg.slotWidth > 0);
+    _slots = vector<PacketArena::Fifo>(_cfg.nSlots);
+    _busy.resize(_cfg.nSlots);
+}
+
+simtime_picosec
+CalendarQueue::rank(Packet &pkt)
+{
+    // Deadline packets carry their slack in ns as priority, others go by arrival.
+    simtime_picosec now = EventList::Get().now();
+    if (pkt.getFlag(Packet::DEADLINE)) {
+        return now + timeFromNs(pkt.getPriority());
+    }
+    return now;
+}
+
+void
+CalendarQueue::beginService()
+{
+    if (_nPackets > 0) {
+        // Rotate to the next busy slot, the calendar moves on by one slot
+        // width for every slot passed.
+        uint32_t slot = _busy.findNextCyclic(_currSlot);
+        assert(slot != Bitmap::NONE);
+
+        uint32_t skipped = (slot >= _currSlot) ? slot - _currSlot : slot + _cfg.nSlots - _currSlot;
+        _currStart += skipped * _cfg.slotWidth;
+        _currSlot = slot;
+
+        // Remove packet from the slot for transmit.
+        _currentPkt = _arena.pop(_slots[slot]);
+        if (_slots[slot].count == 0) {
+            _busy.clear(slot);
+        }
+        _nPackets--;
+
+        // Schedule it's completion time.
+        EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+
+        if (TRACE_PKT == _currentPkt->flow().id) {
+            cout << str() << " Pkt depart sched " << EventList::Get().now() << " "
+                 << _currentPkt->id() << " slot " << _currSlot << " " << _nPackets << endl;
+        }
+    }
+}
+
+void
+CalendarQueue::completeService()
+{
+    // Logging and cleanup.
+    _currentPkt->flow().logTraffic(*_currentPkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*_currentPkt, drainTime(_currentPkt));
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *_currentPkt);
+    }
+
+    applyEcnMark(*_currentPkt);
+    _currentPkt->sendOn();
+
+    // Clear packet being transmitted.
+    _queuesize -= _currentPkt->size();
+    _currentPkt = NULL;
+
+    beginService();
+}
+
+void
+CalendarQueue::receivePacket(Packet &pkt)
+{
+    // If there is no space in the buffer, return immediately.
+    if (_queuesize + pkt.size() > _maxsize) {
+        dropPacket(pkt);
+        return;
+    }
+
+    bool queueWasEmpty = (_currentPkt == NULL) && (_nPackets == 0);
+
+    // Idle calendar starts over at the current time.
+    if (queueWasEmpty) {
+        _currStart = EventList::Get().now();
+    }
+
+    // Find the slot for this packet's rank, ranks in the past go in the current slot.
+    simtime_picosec r = rank(pkt);
+    uint64_t offset = (r > _currStart) ? (r - _currStart) / _cfg.slotWidth : 0;
+
+    if (offset >= _cfg.nSlots) {
+        _nOverflow++;
+        if (_cfg.dropOverflow) {
+            dropPacket(pkt);
+            return;
+        }
+        offset = _cfg.nSlots - 1;
+    }
+
+    uint32_t slot = _currSlot + offset;
+    if (slot >= _cfg.nSlots) {
+        slot -= _cfg.nSlots;
+    }
+
+    if (TRACE_PKT == pkt.flow().id) {
+        cout << str() << " Pkt arrive " << EventList::Get().now() << " " << pkt.id()
+             << " slot " << slot << " " << _currSlot << endl;
+    }
+
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
+
+    _arena.push(_slots[slot], &pkt);
+    _busy.set(slot);
+    _nPackets++;
+    _stats.enqueue(pkt, _queuesize);
+    _queuesize += pkt.size();
+
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    }
+
+    if (queueWasEmpty) {
+        beginService();
+    }
+}
+
+void
+CalendarQueue::printStats()
+{
+    Queue::printStats();
+
+    if (_nOverflow > 0) {
+        printStatsPrefix();
+        cout << " cq-overflow " << _nOverflow << endl;
+    }
+}
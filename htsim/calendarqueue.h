@@ -0,0 +1,60 @@
+#ifndef CALENDAR_QUEUE_H
+#define CALENDAR_QUEUE_H
+
+/*
+ * A calendar queue that drains packets in order of a rank computed at
+ * enqueue, the time by which the packet should depart.
+ *
+ * Packets are placed into a ring of time-slot FIFOs, each slot covering
+ * slotWidth of rank. The queue serves the current slot until it is empty
+ * and then rotates to the next busy slot. Ranks past the end of the
+ * calendar either go into the last slot or are dropped.
+ */
+
+#include "queue.h"
+#include "bitmap.h"
+#include "packetarena.h"
+
+struct CQcfg {
+    // Default values.
+    CQcfg() : nSlots(64), slotWidth(timeFromUs(1)), dropOverflow(false) {}
+
+    uint32_t nSlots;            // Number of time slots in the calendar.
+    simtime_picosec slotWidth;  // Rank covered by each slot.
+    bool dropOverflow;          // Drop packets ranked past the calendar, else keep in last slot.
+};
+
+class CalendarQueue : public Queue
+{
+public:
+    CalendarQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct CQcfg config = CQcfg());
+    void receivePacket(Packet &pkt);
+    void printStats();
+
+protected:
+    void beginService();
+    void completeService();
+
+private:
+    // Departure time a packet is ranked by.
+    simtime_picosec rank(Packet &pkt);
+
+    // Calendar parameters.
+    struct CQcfg _cfg;
+
+    // Time slots, backed by a shared node pool.
+    PacketArena _arena;
+    std::vector<PacketArena::Fifo> _slots;
+    Bitmap _busy;
+
+    uint32_t _currSlot;             // Slot being served.
+    simtime_picosec _currStart;     // Start rank of the current slot.
+    uint64_t _nPackets;             // Packets in the calendar.
+    uint64_t _nOverflow;            // Packets ranked past the calendar.
+
+    // Current packet being serviced.
+    Packet *_currentPkt;
+};
+
+#endif
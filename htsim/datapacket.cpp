@@ -5,3 +5,5 @@
 
 PacketDB<DataPacket> DataPacket::_packetdb;
 PacketDB<DataAck> DataAck::_packetdb;
+
+const uint32_t DataAck::MAX_SACK;
@@ -6,6 +6,8 @@
 
 #include "network.h"
 
+#include <algorithm>
+
 // DataPacket and DataAck are subclasses of Packet used by TcpSrc and other flow control protocols.
 // They incorporate a packet database, to reuse packet objects that are no longer needed.
 // Note: you never construct a new DataPacket or DataAck directly; 
@@ -34,6 +36,25 @@ class DataPacket : public Packet
             _packetdb.freePacket(this);
         }
 
+        // Cuts the first size bytes off into a packet of their own at the
+        // same hop, this one keeps the rest (segmentation offload).
+        DataPacket* split(int size) {
+            DataPacket *p = _packetdb.allocPacket();
+            p->set(flow(), *_route, size, _seqno);
+            p->_seqno = _seqno;
+            p->_ts = _ts;
+            p->_nexthop = _nexthop;
+            p->_flags = _flags;
+            p->_priority = _priority;
+            p->_queuedAt = _queuedAt;
+            flow()._nPackets++;
+
+            _seqno += size;
+            _id = _seqno;
+            _size -= size;
+            return p;
+        }
+
         inline seq_t seqno() const {return _seqno;}
         inline simtime_picosec ts() const {return _ts;}
         inline void set_ts(simtime_picosec ts) {_ts = ts;}
@@ -45,11 +66,20 @@ class DataPacket : public Packet
         static PacketDB<DataPacket> _packetdb;
 };
 
+// Bytes [start, end) a receiver holds above its cumulative ack.
+struct SackBlock {
+    DataPacket::seq_t start;
+    DataPacket::seq_t end;
+};
+
 class DataAck : public Packet
 {
     public:
         typedef DataPacket::seq_t seq_t;
 
+        // SACK blocks that fit in the option space alongside timestamps.
+        static const uint32_t MAX_SACK = 3;
+
         virtual ~DataAck(){}
 
         inline static DataAck* newpkt(PacketFlow &flow, route_t &route, seq_t seqno, seq_t ackno)
@@ -58,6 +88,7 @@ class DataAck : public Packet
             p->set(flow, route, ACK_SIZE, ackno);
             p->_seqno = seqno;
             p->_ackno = ackno;
+            p->_nsack = 0;
             flow._nPackets++;
             return p;
         }
@@ -72,10 +103,22 @@ class DataAck : public Packet
         inline simtime_picosec ts() const {return _ts;}
         inline void set_ts(simtime_picosec ts) {_ts = ts;}
 
+        // Carries up to MAX_SACK blocks, each adding 8 bytes plus 4 of
+        // option header and padding to the ack.
+        void setSack(const SackBlock *blocks, uint32_t n) {
+            _nsack = std::min(n, MAX_SACK);
+            std::copy(blocks, blocks + _nsack, _sack);
+            _size = ACK_SIZE + (_nsack > 0 ? 4 + 8 * _nsack : 0);
+        }
+        inline uint32_t nSack() const {return _nsack;}
+        inline const SackBlock& sack(uint32_t i) const {return _sack[i];}
+
     protected:
         seq_t _seqno;
         seq_t _ackno;
         simtime_picosec _ts;
+        SackBlock _sack[MAX_SACK];
+        uint32_t _nsack;
 
         static PacketDB<DataAck> _packetdb;
 };
@@ -5,7 +5,7 @@
 
 using namespace std;
 
-DataSink::DataSink() : Logged("datasink"), _cumulative_ack(0) {}
+DataSink::DataSink() : Logged("datasink"), _cumulative_ack(0), _last_received(0) {}
 
 void 
 DataSink::connect(DataSource &src, route_t &route)
@@ -25,37 +25,36 @@ DataSink::processDataPacket(DataPacket &pkt)
         _cumulative_ack = seqno + size - 1;
 
         // Are there any additional received packets that we can now ack?
-        while (!_received.empty()) {
-            pair<DataAck::seq_t,mem_b> packet = _received.front();
-
-            if (_cumulative_ack + 1 == packet.first) {
-                _received.pop_front();
-                _cumulative_ack += packet.second;
-            } else {
-                break;
-            }
+        while (!_received.empty() && _received.front().first <= _cumulative_ack + 1) {
+            _cumulative_ack = max(_cumulative_ack, _received.front().second - 1);
+            _received.popFront();
         }
     } else if (seqno <= _cumulative_ack) {
         // Must have been a bad retransmit, do nothing.
     } else {
         // It's not the next expected sequence number.
-        if (_received.empty()) {
-            _received.push_back(make_pair(seqno, size));
-        } else if (seqno > _received.back().first) {
-            _received.push_back(make_pair(seqno, size));
-        } else {
-            // Insert the packet in the right position.
-            for (auto i = _received.begin(); i != _received.end(); i++) {
-                if (seqno == i->first) {
-                    // Probably a bad retransmit.
-                    break;
-                } else if (seqno < i->first) {
-                    _received.insert(i, make_pair(seqno, size));
-                    break;
-                }
-            }
+        _received.insert(seqno, seqno + size);
+        _last_received = seqno;
+    }
+}
+
+uint32_t
+DataSink::sackBlocks(SackBlock *blocks,
+                     uint32_t max)
+{
+    uint32_t n = 0;
+
+    auto recent = _received.find(_last_received);
+    if (recent != _received.end() && n < max) {
+        blocks[n++] = {recent->first, recent->second};
+    }
+
+    for (auto it = _received.begin(); it != _received.end() && n < max; it++) {
+        if (it != recent) {
+            blocks[n++] = {it->first, it->second};
         }
     }
+    return n;
 }
 
 DataAck::seq_t 
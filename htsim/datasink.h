@@ -6,8 +6,7 @@
 
 #include "loggertypes.h"
 #include "datapacket.h"
-
-#include <list>
+#include "intervalset.h"
 
 class DataSource;
 
@@ -25,8 +24,14 @@ class DataSink : public PacketSink, public Logged
         DataAck::seq_t cumulative_ack();
         uint32_t drops();
 
+        // Fills up to max blocks of data held out of order, the one most
+        // recently added to first (RFC 2018), then from the lowest. Returns
+        // the number of blocks.
+        uint32_t sackBlocks(SackBlock *blocks, uint32_t max);
+
         DataAck::seq_t _cumulative_ack;
-        std::list<std::pair<DataAck::seq_t,mem_b> > _received;
+        IntervalSet _received;                // Out of order, above _cumulative_ack.
+        DataAck::seq_t _last_received;        // Start of the latest out of order packet.
 
         uint32_t _node_id;
 
@@ -3,8 +3,12 @@
  */
 #include "datasource.h"
 
+#include <algorithm>
+
 using namespace std;
 
+const simtime_picosec DataSource::TIMER_OFF;
+
 DataSource::DataSource(TrafficLogger *logger, 
                        uint64_t flowsize, 
                        simtime_picosec duration)
@@ -18,9 +22,78 @@ DataSource::DataSource(TrafficLogger *logger,
                       _last_acked(0),
                       _enable_deadline(false),
                       _flowgen(NULL),
-                      _flow(logger)
+                      _flow(logger),
+                      _wakeup(EventList::Get().noEvent()),
+                      _wakeupAt(0)
+{
+    fill(_timers, _timers + N_TIMERS, TIMER_OFF);
+}
+
+DataSource::~DataSource()
+{
+    if (_wakeup != EventList::Get().noEvent()) {
+        EventList::Get().cancelPendingSource(_wakeup);
+    }
+
+    for (route_t *route : _old_routes) {
+        delete route;
+    }
+}
+
+void
+DataSource::doNextEvent()
+{
+    _wakeup = EventList::Get().noEvent();
+
+    // Fire the earliest timer if due, others due now follow on another event.
+    uint32_t timer = min_element(_timers, _timers + N_TIMERS) - _timers;
+    if (_timers[timer] > EventList::Get().now()) {
+        rearm();
+        return;
+    }
+
+    _timers[timer] = TIMER_OFF;
+    rearm();
+
+    // May delete the source.
+    onTimer((Timer)timer);
+}
+
+void
+DataSource::setTimer(Timer timer,
+                     simtime_picosec when)
 {
-    // constructor
+    _timers[timer] = when;
+    rearm();
+}
+
+void
+DataSource::cancelTimer(Timer timer)
+{
+    _timers[timer] = TIMER_OFF;
+    rearm();
+}
+
+void
+DataSource::rearm()
+{
+    EventList &ev = EventList::Get();
+    simtime_picosec next = *min_element(_timers, _timers + N_TIMERS);
+
+    if (_wakeup != ev.noEvent()) {
+        // An earlier wakeup is kept and rearms when it happens, so pushing a
+        // timer back, as every ack does to the RTO, costs no event.
+        if (next != TIMER_OFF && _wakeupAt <= next) {
+            return;
+        }
+        ev.cancelPendingSource(_wakeup);
+        _wakeup = ev.noEvent();
+    }
+
+    if (next != TIMER_OFF) {
+        _wakeupAt = next;
+        _wakeup = ev.sourceIsPending(*this, next);
+    }
 }
 
 void 
@@ -54,5 +127,18 @@ DataSource::connect(simtime_picosec start_time,
     cout << str() << " " << timeAsUs(_start_time) << " " << id << " " << _flowsize << " " << _node_id << " " << _sink->_node_id << endl;
 
     _sink->connect(*this, *_route_rev);
-    EventList::Get().sourceIsPending(*this, _start_time);
+    setTimer(START, _start_time);
+}
+
+void
+DataSource::reroute(route_t &route_fwd,
+                    route_t &route_rev)
+{
+    _old_routes.push_back(_route_fwd);
+    _old_routes.push_back(_route_rev);
+
+    _route_fwd = &route_fwd;
+    _route_rev = &route_rev;
+
+    _sink->connect(*this, *_route_rev);
 }
@@ -17,7 +17,7 @@ class DataSource : public EventSource, public PacketSink
 {
     public:
         DataSource(TrafficLogger *logger, uint64_t flowsize, simtime_picosec duration);
-        virtual ~DataSource() {};
+        virtual ~DataSource();
 
         /* Different types of endhost that implement DataSource */
         enum EndHost {
@@ -29,12 +29,35 @@ class DataSource : public EventSource, public PacketSink
             TIMELY
         };
 
+        /* Timers of a source. An armed timer fires once, unless cancelled or
+         * armed again first, with the source woken only for armed timers.
+         * connect() arms START. */
+        enum Timer {
+            START,    // Flow start
+            RTO,      // Retransmission timeout
+            PACING,   // Next paced transmission
+            TEARDOWN, // Deletes a finished flow once its packets are gone
+            N_TIMERS
+        };
+
         virtual void printStatus() = 0;
-        virtual void doNextEvent() = 0;
         virtual void receivePacket(Packet &pkt) = 0;
 
+        /* Runs timers that are due, sources implement onTimer(). */
+        void doNextEvent();
+
+        void setTimer(Timer timer, simtime_picosec when);
+        void cancelTimer(Timer timer);
+        bool timerSet(Timer timer) const { return _timers[timer] != TIMER_OFF; }
+
+        /* When the timer fires, 0 if not set. */
+        simtime_picosec timer(Timer timer) const { return timerSet(timer) ? _timers[timer] : 0; }
+
         void connect(simtime_picosec start_time, route_t &route_fwd, route_t &route_rev, DataSink &sink);
 
+        /* Moves the flow onto new routes, packets in flight finish on the old ones. */
+        void reroute(route_t &route_fwd, route_t &route_rev);
+
         void setFlowGenerator(FlowGenerator *flowgen);
         void setDeadline(simtime_picosec deadline);
 
@@ -52,11 +75,25 @@ class DataSource : public EventSource, public PacketSink
         DataSink *_sink;
         route_t *_route_fwd;
         route_t *_route_rev;
+        std::vector<route_t *> _old_routes; // Replaced, deleted with the source.
 
         FlowGenerator *_flowgen;
         PacketFlow _flow;
 
         uint32_t _node_id;
+
+    protected:
+        virtual void onTimer(Timer timer) = 0;
+
+    private:
+        static const simtime_picosec TIMER_OFF = UINT64_MAX;
+
+        // Keeps one event pending for the earliest timer.
+        void rearm();
+
+        simtime_picosec _timers[N_TIMERS];
+        EventList::Handle _wakeup;    // Pending event, or noEvent().
+        simtime_picosec _wakeupAt;
 };
 
 #endif /* DATASOURCE_H */
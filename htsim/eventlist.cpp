@@ -70,13 +70,14 @@ EventList::doNextEvent()
     return true;
 }
 
-void 
+EventList::Handle
 EventList::sourceIsPending(EventSource &src,
                            simtime_picosec when) 
 {
     assert(when >= now());
 
     if (_endtime == 0 || when <= _endtime) {
-        _pendingsources.insert(make_pair(when, &src));
+        return _pendingsources.insert(make_pair(when, &src));
     }
+    return noEvent();
 }
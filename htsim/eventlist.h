@@ -21,7 +21,12 @@ class EventSource : public Logged
 
 class EventList
 {
+    typedef std::multimap<simtime_picosec,EventSource*> pendingsources_t;
+
     public:
+        // A pending event, valid until it happens or is cancelled.
+        typedef pendingsources_t::iterator Handle;
+
         // Returns the eventlist instance.
         static EventList& Get();
 
@@ -31,13 +36,18 @@ class EventList
         // Returns true if it did anything, false if there's nothing to do.
         bool doNextEvent();
 
-        // Enqueue future events into the simulator.
-        void sourceIsPending(EventSource &src, simtime_picosec when);
+        // Enqueue future events into the simulator. Events past the end time
+        // are not kept and get noEvent().
+        Handle sourceIsPending(EventSource &src, simtime_picosec when);
         void sourceIsPendingRel(EventSource &src, simtime_picosec timefromnow)
         {
             sourceIsPending(src, now() + timefromnow);
         }
 
+        // Removes an event before it happens.
+        void cancelPendingSource(Handle event) { _pendingsources.erase(event); }
+        Handle noEvent() { return _pendingsources.end(); }
+
         // Returns current simulation time.
         inline simtime_picosec now() {return _lasteventtime;}
 
@@ -52,7 +62,6 @@ class EventList
 
         static EventList *instance;
 
-        typedef std::multimap<simtime_picosec,EventSource*> pendingsources_t;
         pendingsources_t _pendingsources;
         simtime_picosec _endtime;
         simtime_picosec _lasteventtime;
@@ -1,17 +1,22 @@
 #include "exoqueue.h"
 
-ExoQueue::ExoQueue(double loss_rate) : _loss_rate(loss_rate) {}
+ExoQueue::ExoQueue(double loss_rate)
+{
+    _loss.setRate(loss_rate);
+}
+
+ExoQueue::ExoQueue(const LossModel &loss) : _loss(loss) {}
 
 void
 ExoQueue::setLossRate(double l)
 {
-    _loss_rate = l;
+    _loss.setRate(l);
 }
 
 void
 ExoQueue::receivePacket(Packet &pkt) 
 {
-    if (drand() < _loss_rate) {
+    if (_loss.drop()) {
         pkt.free();
         return;
     }
@@ -2,20 +2,23 @@
 #define EXOQUEUE_H
 
 /*
- * A simple exogenous queue
+ * A simple exogenous queue, losing packets by a loss model. Placed in a
+ * route after a pipe it makes that link lossy.
  */
 
 #include "network.h"
+#include "lossmodel.h"
 
 class ExoQueue : public PacketSink
 {
 public:
     ExoQueue(double loss_rate);
+    ExoQueue(const LossModel &loss);
     void receivePacket(Packet &pkt);
     void setLossRate(double l);
 
     // Housekeeping
-    double _loss_rate;
+    LossModel _loss;
 };
 
 #endif
@@ -2,6 +2,9 @@
  * Flow generator
  */
 #include "flow-generator.h"
+#include "pipe.h"
+#include "queuet.h"
+#include "tsoqueue.h"
 
 using namespace std;
 
@@ -19,6 +22,7 @@ FlowGenerator::FlowGenerator(DataSource::EndHost endhost,
     _flowsGenerated(0),
     _workload(avgFlowSize, flowSizeDist),
     _endhostQ(false),
+    _tsoBytes(0),
     _useTrace(false),
     _replaceFlow(false),
     _maxFlows(0),
@@ -53,6 +57,12 @@ FlowGenerator::setEndhostQueue(linkspeed_bps qRate,
     _endhostQbuffer = qBuffer;
 }
 
+void
+FlowGenerator::setSegmentOffload(uint32_t tsoBytes)
+{
+    _tsoBytes = min(tsoBytes, TsoQueue::MAX_BYTES);
+}
+
 void
 FlowGenerator::setReplaceFlow(uint32_t maxFlows, 
                               double offRatio)
@@ -66,6 +76,12 @@ FlowGenerator::setReplaceFlow(uint32_t maxFlows,
     _avgOffTime = llround(timeFromSec(avgFCT) * offRatio / (1 + offRatio));
 }
 
+void
+FlowGenerator::setRepathRoute(route_gen_t rg)
+{
+    _repathGen = rg;
+}
+
 void
 FlowGenerator::setPrefix(string prefix)
 {
@@ -150,8 +166,14 @@ FlowGenerator::createFlow(uint64_t flowSize,
     simtime_picosec deadline = timeFromSec((flowSize * 8.0) / speedFromGbps(0.8));
 
     // If flag set, append an endhost queue.
+    bool tso = (_endhostQ && _tsoBytes > MSS_BYTES);
     if (_endhostQ) {
-        Queue *endhostQ = new Queue(_endhostQrate, _endhostQbuffer, NULL);
+        Queue *endhostQ;
+        if (tso) {
+            endhostQ = new TsoQueue(_endhostQrate, _endhostQbuffer, NULL);
+        } else {
+            endhostQ = new DropTailQueue(_endhostQrate, _endhostQbuffer, NULL);
+        }
         routeFwd->insert(routeFwd->begin(), endhostQ);
     }
 
@@ -181,6 +203,10 @@ FlowGenerator::createFlow(uint64_t flowSize,
                      if (_endhost == DataSource::D_TCP || _endhost == DataSource::D_DCTCP) {
                          src->_enable_deadline = true;
                      }
+
+                     if (tso) {
+                         static_cast<TcpSrc*>(src)->_tso_bytes = _tsoBytes;
+                     }
                  }
     }
 
@@ -201,6 +227,47 @@ FlowGenerator::createFlow(uint64_t flowSize,
     _flowsGenerated++;
 }
 
+static bool
+routeFailed(const route_t &route)
+{
+    for (PacketSink *hop : route) {
+        Pipe *pipe = dynamic_cast<Pipe *>(hop);
+        if (pipe && !pipe->isUp()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+FlowGenerator::repath(DataSource &src)
+{
+    if (!_repathGen || (!routeFailed(*src._route_fwd) && !routeFailed(*src._route_rev))) {
+        return false;
+    }
+
+    route_t *routeFwd = NULL, *routeRev = NULL;
+    uint32_t src_node = src._node_id, dst_node = src._sink->_node_id;
+    _repathGen(routeFwd, routeRev, src_node, dst_node);
+
+    // No path around the failure, e.g. the server's own link is down.
+    if (routeFailed(*routeFwd) || routeFailed(*routeRev)) {
+        delete routeFwd;
+        delete routeRev;
+        return false;
+    }
+
+    // The flow keeps its endhost queue.
+    if (_endhostQ) {
+        routeFwd->insert(routeFwd->begin(), src._route_fwd->front());
+    }
+
+    routeFwd->push_back(src._sink);
+    routeRev->push_back(&src);
+    src.reroute(*routeFwd, *routeRev);
+    return true;
+}
+
 void
 FlowGenerator::finishFlow(uint32_t flow_id)
 {
@@ -33,6 +33,10 @@ class FlowGenerator : public EventSource
         /* Creates a separate endhost queue for every flow. */
         void setEndhostQueue(linkspeed_bps qRate, uint64_t qBuffer);
 
+        /* TCP sources hand segments of up to tsoBytes to an endhost queue that
+         * cuts them to MSS as it serializes. Needs the endhost queue. */
+        void setSegmentOffload(uint32_t tsoBytes);
+
         /* Fixes max flows in the systems and replaces them when finished. */
         void setReplaceFlow(uint32_t maxFlows, double offRatio);
 
@@ -42,6 +46,15 @@ class FlowGenerator : public EventSource
         /* Flow arrival using a trace instead of dynamic generation during simulation. */
         void setTrace(std::string filename);
 
+        /* Route generator for flows between given nodes, src and dst set on entry.
+         * Enables repathing flows away from failed links. */
+        void setRepathRoute(route_gen_t rg);
+
+        /* Used by a source on timeout. Moves the flow onto a new route if a link
+         * on its current one has failed and one avoiding failures exists,
+         * returns whether it did. */
+        bool repath(DataSource &src);
+
         /* Used by Source to notify the Generator of flow finishing, which can then
          * (optionally) generate a new flow. */
         void finishFlow(uint32_t flow_id);
@@ -57,6 +70,7 @@ class FlowGenerator : public EventSource
         std::string _prefix;          // Optional prefix for flows.
         DataSource::EndHost _endhost; // Type of endhost.
         route_gen_t _routeGen;        // Function to generate a route.
+        route_gen_t _repathGen;       // Function to generate a route between given nodes.
         linkspeed_bps _flowRate;      // Target flow rate in bytes/sec.
         uint32_t _flowSizeDist;       // Distribution of flow size [0/1/2] - Uniform/Exp/Pareto.
         uint32_t _flowsGenerated;     // Total number of flow generated.
@@ -67,6 +81,7 @@ class FlowGenerator : public EventSource
         bool _endhostQ;
         linkspeed_bps _endhostQrate;
         uint64_t _endhostQbuffer;
+        uint32_t _tsoBytes;           // Segment offload size, 0 if off.
 
         // Flow replacement configuration.
         bool _useTrace;               // Use a trace for flow generations.
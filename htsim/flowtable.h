@@ -0,0 +1,207 @@
+#ifndef FLOW_TABLE_H
+#define FLOW_TABLE_H
+
+/*
+ * An open-addressing hash table keyed by flow id.
+ *
+ * Uses Robin Hood linear probing with backward-shift deletion, so there
+ * are no tombstones and lookups stop as soon as they pass an entry that
+ * is closer to its home slot than the key being searched for. All state
+ * for a flow lives in one contiguous slot, next to its key.
+ */
+
+#include "htsim.h"
+
+#include <vector>
+
+template<class V>
+class FlowTable
+{
+public:
+    // Flow id reserved to mark empty slots.
+    static const uint32_t EMPTY = 0xffffffff;
+
+    FlowTable(uint32_t capacity = 64) : _size(0)
+    {
+        uint32_t cap = 16;
+        while (cap < 2 * capacity) {
+            cap <<= 1;
+        }
+        resize(cap);
+    }
+
+    // Returns the value stored for a flow, or NULL if not present.
+    inline V* find(uint32_t key)
+    {
+        uint32_t idx = home(key);
+        for (uint32_t dist = 0; ; dist++, idx = (idx + 1) & _mask) {
+            Slot &s = _slots[idx];
+            if (s.key == key) {
+                return &s.value;
+            }
+            if (s.key == EMPTY || distance(s.key, idx) < dist) {
+                return NULL;
+            }
+        }
+    }
+
+    // Returns the value stored for a flow, inserting a default one if not
+    // present. The returned reference is valid until the next insert/erase.
+    inline V& findOrInsert(uint32_t key, bool &inserted)
+    {
+        V *v = find(key);
+        if (v != NULL) {
+            inserted = false;
+            return *v;
+        }
+        inserted = true;
+        return insert(key);
+    }
+
+    inline V& operator[](uint32_t key)
+    {
+        bool inserted;
+        return findOrInsert(key, inserted);
+    }
+
+    // Removes a flow from the table, returns false if it wasn't present.
+    bool erase(uint32_t key)
+    {
+        uint32_t idx = home(key);
+        for (uint32_t dist = 0; ; dist++, idx = (idx + 1) & _mask) {
+            Slot &s = _slots[idx];
+            if (s.key == EMPTY || distance(s.key, idx) < dist) {
+                return false;
+            }
+            if (s.key == key) {
+                break;
+            }
+        }
+
+        // Shift following entries back until one is empty or at its home.
+        uint32_t next = (idx + 1) & _mask;
+        while (_slots[next].key != EMPTY && distance(_slots[next].key, next) > 0) {
+            _slots[idx] = _slots[next];
+            idx = next;
+            next = (next + 1) & _mask;
+        }
+        _slots[idx].key = EMPTY;
+        _slots[idx].value = V();
+        _size--;
+        return true;
+    }
+
+    // Calls f(key, value) for every flow in the table.
+    template<class F>
+    void forEach(F f)
+    {
+        for (auto &s : _slots) {
+            if (s.key != EMPTY) {
+                f(s.key, s.value);
+            }
+        }
+    }
+
+    void clear()
+    {
+        for (auto &s : _slots) {
+            s.key = EMPTY;
+            s.value = V();
+        }
+        _size = 0;
+    }
+
+    inline uint32_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+
+    // Bytes of memory held by the table.
+    inline uint64_t memoryBytes() const { return _slots.size() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        Slot() : key(EMPTY), value() {}
+        uint32_t key;
+        V value;
+    };
+
+    inline uint32_t home(uint32_t key) const
+    {
+        // Fibonacci hashing, flow ids are mostly sequential.
+        return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> _shift);
+    }
+
+    inline uint32_t distance(uint32_t key, uint32_t idx) const
+    {
+        return (idx - home(key)) & _mask;
+    }
+
+    V& insert(uint32_t key)
+    {
+        if (2 * (_size + 1) > _slots.size()) {
+            grow();
+        }
+
+        Slot cur;
+        cur.key = key;
+        uint32_t idx = home(key);
+        uint32_t dist = 0;
+        int32_t placed = -1;
+
+        while (true) {
+            Slot &s = _slots[idx];
+            if (s.key == EMPTY) {
+                s = cur;
+                if (placed < 0) {
+                    placed = idx;
+                }
+                break;
+            }
+
+            // Robin Hood: steal the slot from entries closer to their home.
+            uint32_t d = distance(s.key, idx);
+            if (d < dist) {
+                std::swap(s, cur);
+                if (placed < 0) {
+                    placed = idx;
+                }
+                dist = d;
+            }
+            idx = (idx + 1) & _mask;
+            dist++;
+        }
+
+        _size++;
+        return _slots[placed].value;
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old;
+        old.swap(_slots);
+        resize(old.size() * 2);
+        _size = 0;
+        for (auto &s : old) {
+            if (s.key != EMPTY) {
+                insert(s.key) = s.value;
+            }
+        }
+    }
+
+    void resize(uint32_t cap)
+    {
+        _slots.assign(cap, Slot());
+        _mask = cap - 1;
+        _shift = 64;
+        while (cap > 1) {
+            cap >>= 1;
+            _shift--;
+        }
+    }
+
+    std::vector<Slot> _slots;
+    uint32_t _mask;
+    uint32_t _shift;
+    uint32_t _size;
+};
+
+#endif /* FLOW_TABLE_H */
@@ -0,0 +1,255 @@
+#include "hierqueue.h"
+
+#define TRACE_PKT 0 && 4304
+
+using namespace std;
+
+HierQueue::HierQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct HQcfg config)
+    : Queue(bitrate, maxsize, logger), _cfg(config), _arena(maxsize / MSS_BYTES),
+      _currentPkt(NULL)
+{
+    size_t pos = 0;
+    parseNode(_cfg.tree, pos, PacketArena::NIL);
+    if (pos != _cfg.tree.size()) {
+        parseError(_cfg.tree, pos);
+    }
+}
+
+HierQueue::~HierQueue()
+{
+    for (auto &n : _nodes) {
+        delete n.fq;
+    }
+}
+
+uint32_t
+HierQueue::parseNode(const string &s, size_t &pos, uint32_t parent)
+{
+    size_t end = s.find_first_of("(,):", pos);
+    if (end == string::npos) {
+        end = s.size();
+    }
+    string name = s.substr(pos, end - pos);
+    pos = end;
+
+    uint32_t id = _nodes.size();
+    if (name == "fifo") {
+        _nodes.push_back(Node(Node::FIFO, parent));
+        _leaves.push_back(id);
+    } else if (name == "fq") {
+        _nodes.push_back(Node(Node::FQ, parent));
+        _nodes[id].fq = new FqLeaf();
+        _leaves.push_back(id);
+    } else if (name == "sp" || name == "drr") {
+        _nodes.push_back(Node(name == "sp" ? Node::SP : Node::DRR, parent));
+        if (pos >= s.size() || s[pos] != '(') {
+            parseError(s, pos);
+        }
+        do {
+            pos++;
+            uint32_t child = parseNode(s, pos, id);
+            _nodes[id].children.push_back(child);
+        } while (pos < s.size() && s[pos] == ',');
+        if (pos >= s.size() || s[pos] != ')') {
+            parseError(s, pos);
+        }
+        pos++;
+    } else {
+        parseError(s, pos - name.size());
+    }
+
+    // Optional weight.
+    if (pos < s.size() && s[pos] == ':') {
+        size_t digits = s.find_first_not_of("0123456789", ++pos);
+        if (digits == string::npos) {
+            digits = s.size();
+        }
+        // Nine digits keep stoul in range and the weight in 32 bits, and a
+        // zero weight would never earn its DRR child any credit.
+        if (digits == pos || digits - pos > 9) {
+            parseError(s, pos);
+        }
+        _nodes[id].weight = stoul(s.substr(pos, digits - pos));
+        if (_nodes[id].weight == 0) {
+            parseError(s, pos);
+        }
+        pos = digits;
+    }
+
+    return id;
+}
+
+void
+HierQueue::parseError(const string &s, size_t pos)
+{
+    cerr << "Bad scheduling tree " << s << " at " << pos << endl;
+    exit(1);
+}
+
+uint32_t
+HierQueue::classify(Packet &pkt)
+{
+    uint32_t nLeaves = _leaves.size();
+
+    // Flow ids are handed out in strides, mix them before taking the modulo.
+    uint32_t flowid = (uint32_t)((pkt.flow().id * 0x9E3779B97F4A7C15ULL) >> 32);
+
+    if (_cfg.classify == HQcfg::DEADLINE && nLeaves > 1) {
+        if (pkt.getFlag(Packet::DEADLINE)) {
+            return _leaves[0];
+        }
+        return _leaves[1 + flowid % (nLeaves - 1)];
+    }
+    return _leaves[flowid % nLeaves];
+}
+
+Packet*
+HierQueue::dequeue(uint32_t node)
+{
+    Node &n = _nodes[node];
+    assert(n.nPackets > 0);
+    n.nPackets--;
+
+    switch (n.type) {
+        case Node::FIFO:
+            return _arena.pop(n.fifo);
+
+        case Node::FQ: {
+            FqLeaf &fq = *n.fq;
+            Pifo::Entry e = fq.pifo.pop();
+            fq.rank.dequeue(*e.pkt, e.rank);
+
+            uint32_t flowid = e.pkt->flow().id;
+            FqLeaf::FlowEntry *fe = fq.flows.find(flowid);
+            if (fe->nPackets == 1) {
+                fq.flows.erase(flowid);
+            } else {
+                fe->nPackets--;
+            }
+            return e.pkt;
+        }
+
+        case Node::SP:
+            for (uint32_t c : n.children) {
+                if (_nodes[c].nPackets > 0) {
+                    return dequeue(c);
+                }
+            }
+            break;
+
+        case Node::DRR: {
+            // Hand out quanta until the head child has credit left. A child
+            // may overdraw by one packet, which it pays back next round.
+            uint32_t c;
+            while (true) {
+                c = n.active.front();
+                if (_nodes[c].deficit > 0) {
+                    break;
+                }
+                _nodes[c].deficit += (int64_t)_nodes[c].weight * MSS_BYTES;
+                n.active.pop_front();
+                n.active.push_back(c);
+            }
+
+            Packet *pkt = dequeue(c);
+            _nodes[c].deficit -= pkt->size();
+            if (_nodes[c].nPackets == 0) {
+                n.active.pop_front();
+                _nodes[c].deficit = 0;
+            }
+            return pkt;
+        }
+    }
+
+    assert(false);
+    return NULL;
+}
+
+void
+HierQueue::beginService()
+{
+    if (_nodes[0].nPackets > 0) {
+        _currentPkt = dequeue(0);
+
+        // Schedule it's completion time.
+        EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+
+        if (TRACE_PKT == _currentPkt->flow().id) {
+            cout << str() << " Pkt depart sched " << EventList::Get().now() << " "
+                 << _currentPkt->id() << " " << _nodes[0].nPackets << endl;
+        }
+    }
+}
+
+void
+HierQueue::completeService()
+{
+    // Logging and cleanup.
+    _currentPkt->flow().logTraffic(*_currentPkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*_currentPkt, drainTime(_currentPkt));
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *_currentPkt);
+    }
+
+    applyEcnMark(*_currentPkt);
+    _currentPkt->sendOn();
+
+    // Clear packet being transmitted.
+    _queuesize -= _currentPkt->size();
+    _currentPkt = NULL;
+
+    beginService();
+}
+
+void
+HierQueue::receivePacket(Packet &pkt)
+{
+    // If there is no space in the port buffer, return immediately.
+    if (_queuesize + pkt.size() > _maxsize) {
+        dropPacket(pkt);
+        return;
+    }
+
+    bool queueWasEmpty = (_currentPkt == NULL) && (_nodes[0].nPackets == 0);
+    uint32_t leaf = classify(pkt);
+
+    if (TRACE_PKT == pkt.flow().id) {
+        cout << str() << " Pkt arrive " << EventList::Get().now() << " " << pkt.id()
+             << " leaf " << leaf << endl;
+    }
+
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
+
+    Node &l = _nodes[leaf];
+    if (l.type == Node::FIFO) {
+        _arena.push(l.fifo, &pkt);
+    } else {
+        FqLeaf &fq = *l.fq;
+        FqLeaf::FlowEntry &fe = fq.flows[pkt.flow().id];
+        fe.nPackets++;
+        fq.pifo.push(fq.rank.rank(pkt, fe.state, *this), &pkt);
+    }
+
+    // Count the packet up to the root, activating idle DRR children.
+    for (uint32_t n = leaf; n != PacketArena::NIL; n = _nodes[n].parent) {
+        bool wasIdle = (_nodes[n].nPackets == 0);
+        _nodes[n].nPackets++;
+
+        uint32_t parent = _nodes[n].parent;
+        if (wasIdle && parent != PacketArena::NIL && _nodes[parent].type == Node::DRR) {
+            _nodes[parent].active.push_back(n);
+        }
+    }
+
+    _stats.enqueue(pkt, _queuesize);
+    _queuesize += pkt.size();
+
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    }
+
+    if (queueWasEmpty) {
+        beginService();
+    }
+}
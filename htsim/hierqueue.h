@@ -0,0 +1,106 @@
+#ifndef HIER_QUEUE_H
+#define HIER_QUEUE_H
+
+/*
+ * A hierarchical scheduler for one port.
+ *
+ * The port is a tree of scheduling nodes. Leaves hold packets, either in a
+ * FIFO or fair-queued by flow (start-time fair queueing). Internal nodes
+ * pick among their children by strict priority (first child first) or by
+ * DRR with a quantum of weight MSS-sized packets per round. The whole tree
+ * is one Queue, so the port schedules a single departure at a time.
+ *
+ * Trees are given as a string, for example "sp(fifo,drr(fq:3,fq))":
+ *
+ *   node := ("fifo" | "fq" | ("sp" | "drr") "(" node {"," node} ")") [":" weight]
+ *
+ * Packets are classified to leaves numbered left to right.
+ */
+
+#include "queue.h"
+#include "packetarena.h"
+#include "pifoqueue.h"
+
+#include <deque>
+#include <string>
+
+struct HQcfg {
+    // Default values.
+    HQcfg() : tree("sp(fifo,drr(fq,fq))"), classify(DEADLINE) {}
+
+    std::string tree;   // Scheduling tree.
+
+    // How packets are mapped to leaves.
+    enum Classify {
+        FLOW,           // Hash of the flow id.
+        DEADLINE        // Deadline packets to the first leaf, others by flow hash.
+    } classify;
+};
+
+class HierQueue : public Queue
+{
+public:
+    HierQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct HQcfg config = HQcfg());
+    ~HierQueue();
+    void receivePacket(Packet &pkt);
+
+protected:
+    void beginService();
+    void completeService();
+
+private:
+    // Leaf that fair-queues its packets by flow.
+    struct FqLeaf {
+        struct FlowEntry {
+            FlowEntry() : nPackets(0) {}
+            uint32_t nPackets;
+            StfqRank::FlowState state;
+        };
+
+        StfqRank rank;
+        FlowTable<FlowEntry> flows;
+        Pifo pifo;
+    };
+
+    struct Node {
+        enum Type {FIFO, FQ, SP, DRR};
+
+        Node(Type t, uint32_t p) : type(t), parent(p), weight(1), nPackets(0),
+                                   fq(NULL), deficit(0) {}
+
+        Type type;
+        uint32_t parent;                // Parent node, NIL for the root.
+        uint32_t weight;                // DRR weight, as a child of a DRR node.
+        std::vector<uint32_t> children;
+        uint64_t nPackets;              // Packets queued below this node.
+
+        PacketArena::Fifo fifo;         // FIFO leaf packets.
+        FqLeaf *fq;                     // FQ leaf packets.
+
+        std::deque<uint32_t> active;    // DRR children with packets, head is served.
+        int64_t deficit;                // Bytes left this round, as a child of a DRR node.
+    };
+
+    // Tree construction from the config string.
+    uint32_t parseNode(const std::string &s, size_t &pos, uint32_t parent);
+    void parseError(const std::string &s, size_t pos);
+
+    // Leaf an arriving packet belongs to.
+    uint32_t classify(Packet &pkt);
+
+    // Removes the next packet below a node with packets.
+    Packet* dequeue(uint32_t node);
+
+    struct HQcfg _cfg;
+    std::vector<Node> _nodes;       // Tree nodes, root first.
+    std::vector<uint32_t> _leaves;  // Leaf nodes in class order.
+
+    // Shared node pool for FIFO leaves.
+    PacketArena _arena;
+
+    // Current packet being serviced.
+    Packet *_currentPkt;
+};
+
+#endif
@@ -58,13 +58,23 @@ pareto(double alpha, int mean)
     return (int)(scale / pow(drand(), 1/alpha));
 }
 
-inline double 
+inline double
 exponential(double lambda)
 {
     // mean is 1/lambda
     return -log(drand())/lambda;
 }
 
+inline uint64_t
+splitmix64(uint64_t &state)
+{
+    // Deterministic generator for hash seeds, independent of rand().
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 
 /* Time conversions. */
 inline simtime_picosec 
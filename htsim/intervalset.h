@@ -0,0 +1,86 @@
+#ifndef INTERVAL_SET_H
+#define INTERVAL_SET_H
+
+/*
+ * A set of byte ranges [start, end). Ranges that overlap or touch are
+ * coalesced on insert, so data held out of order at a receiver is a few
+ * ranges however many segments it spans, one per hole. Insert and
+ * removal from the front are O(log ranges).
+ */
+
+#include "htsim.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+class IntervalSet
+{
+public:
+    typedef uint64_t value_t;
+    typedef std::map<value_t, value_t>::const_iterator const_iterator;
+    typedef std::map<value_t, value_t>::const_reverse_iterator const_reverse_iterator;
+
+    // Adds [start, end), returns the range now holding it.
+    const_iterator insert(value_t start, value_t end)
+    {
+        auto it = _ranges.upper_bound(start);
+        if (it != _ranges.begin() && std::prev(it)->second >= start) {
+            it--;
+            if (it->second >= end) {
+                return it;
+            }
+        } else {
+            it = _ranges.emplace_hint(it, start, end);
+        }
+
+        // Absorb the ranges the new one reaches.
+        auto next = std::next(it);
+        while (next != _ranges.end() && next->first <= end) {
+            end = std::max(end, next->second);
+            next = _ranges.erase(next);
+        }
+        it->second = std::max(it->second, end);
+        return it;
+    }
+
+    // Range holding v, or end().
+    const_iterator find(value_t v) const
+    {
+        auto it = _ranges.upper_bound(v);
+        if (it == _ranges.begin() || std::prev(it)->second <= v) {
+            return _ranges.end();
+        }
+        return std::prev(it);
+    }
+
+    inline bool empty() const { return _ranges.empty(); }
+    inline size_t size() const { return _ranges.size(); }
+
+    inline const std::pair<const value_t, value_t>& front() const { return *_ranges.begin(); }
+    inline void popFront() { _ranges.erase(_ranges.begin()); }
+    inline void clear() { _ranges.clear(); }
+
+    // Drops everything below v, trimming a range that straddles it.
+    void eraseBelow(value_t v)
+    {
+        while (!_ranges.empty() && _ranges.begin()->first < v) {
+            value_t end = _ranges.begin()->second;
+            _ranges.erase(_ranges.begin());
+            if (end > v) {
+                _ranges.emplace(v, end);
+                break;
+            }
+        }
+    }
+
+    inline const_iterator begin() const { return _ranges.begin(); }
+    inline const_iterator end() const { return _ranges.end(); }
+    inline const_reverse_iterator rbegin() const { return _ranges.rbegin(); }
+    inline const_reverse_iterator rend() const { return _ranges.rend(); }
+
+private:
+    std::map<value_t, value_t> _ranges;   // Start to end.
+};
+
+#endif
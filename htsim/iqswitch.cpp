@@ -0,0 +1,198 @@
+#include "iqswitch.h"
+#include "prof.h"
+
+using namespace std;
+
+IqSwitch::IqSwitch(const string &name, struct IQcfg config, simtime_picosec period)
+    : EventSource(name), _cfg(config), _period(period), _slot(0), _running(false),
+      _queued(0), _peak(0), _nDrops(0), _nSlots(0), _nMatches(0), _nUnmatched(0),
+      _nextReport(period)
+{
+    assert(_cfg.iterations > 0 && _cfg.speedup > 0);
+}
+
+void
+IqSwitch::addOutput(Queue *queue)
+{
+    assert(_inputs.empty());
+
+    _outputIndex[queue] = _outputs.size();
+    _outputs.push_back(queue);
+    _requesters.push_back(Bitmap());
+    _grantPtr.push_back(0);
+
+    // The fabric keeps up with the fastest output at speedup one.
+    simtime_picosec slot = (simtime_picosec)(MSS_BYTES * (8 * 1000000000000UL / queue->bitrate())
+                                             / _cfg.speedup);
+    if (_slot == 0 || slot < _slot) {
+        _slot = slot;
+    }
+    _freeOutputs.resize(_outputs.size());
+}
+
+PacketSink*
+IqSwitch::addInput()
+{
+    uint32_t in = _inputs.size();
+    _inputs.push_back(new Input(*this, in));
+
+    _voqs.resize(_voqs.size() + _outputs.size());
+    _inputBytes.push_back(0);
+    _requests.push_back(Bitmap(_outputs.size()));
+    _grants.push_back(Bitmap(_outputs.size()));
+    _acceptPtr.push_back(0);
+    for (auto &r : _requesters) {
+        r.resize(_inputs.size());
+    }
+    _freeInputs.resize(_inputs.size());
+
+    return _inputs.back();
+}
+
+void
+IqSwitch::receivePacket(uint32_t in, Packet &pkt)
+{
+    auto it = _outputIndex.find(pkt.nextHop());
+    assert(it != _outputIndex.end());
+    uint32_t out = it->second;
+
+    if (_inputBytes[in] + pkt.size() > _cfg.inputBuffer) {
+        _nDrops++;
+        pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
+        pkt.free();
+        return;
+    }
+
+    _arena.push(voq(in, out), &pkt);
+    _inputBytes[in] += pkt.size();
+    _queued += pkt.size();
+    _peak = max(_peak, _queued);
+    _requests[in].set(out);
+    _requesters[out].set(in);
+
+    if (!_running) {
+        _running = true;
+        EventList::Get().sourceIsPendingRel(*this, 0);
+    }
+}
+
+void
+IqSwitch::match()
+{
+    _matches.clear();
+
+    for (uint32_t in = 0; in < _inputs.size(); in++) {
+        _freeInputs.set(in);
+    }
+    for (uint32_t out = 0; out < _outputs.size(); out++) {
+        // Outputs with a full egress queue take no packets this slot.
+        if (_requesters[out].any() &&
+            (_cfg.outputBuffer == 0 || _outputs[out]->_queuesize < _cfg.outputBuffer)) {
+            _freeOutputs.set(out);
+        } else {
+            _freeOutputs.clear(out);
+        }
+    }
+
+    for (uint32_t iter = 0; iter < _cfg.iterations && _freeOutputs.any(); iter++) {
+        // Grant, each free output picks the next requesting free input.
+        _granted.clear();
+        for (uint32_t out = _freeOutputs.findNext(0); out != Bitmap::NONE;
+             out = _freeOutputs.findNext(out + 1)) {
+            uint32_t in = _requesters[out].findNextCyclic(_grantPtr[out], _freeInputs);
+            if (in != Bitmap::NONE) {
+                if (!_grants[in].any()) {
+                    _granted.push_back(in);
+                }
+                _grants[in].set(out);
+            }
+        }
+        if (_granted.empty()) {
+            break;
+        }
+
+        // Accept, each granted input picks the next granting output.
+        for (auto in : _granted) {
+            uint32_t out = _grants[in].findNextCyclic(_acceptPtr[in]);
+            _matches.push_back(make_pair(in, out));
+            _freeInputs.clear(in);
+            _freeOutputs.clear(out);
+
+            if (iter == 0) {
+                _acceptPtr[in] = (out + 1) % _outputs.size();
+                _grantPtr[out] = (in + 1) % _inputs.size();
+            }
+
+            for (uint32_t g = _grants[in].findNext(0); g != Bitmap::NONE;
+                 g = _grants[in].findNext(g + 1)) {
+                _grants[in].clear(g);
+            }
+        }
+    }
+}
+
+void
+IqSwitch::transfer(uint32_t in, uint32_t out)
+{
+    PacketArena::Fifo &q = voq(in, out);
+    int64_t budget = MSS_BYTES;
+
+    // Small packets share the slot, as cells of one frame would.
+    do {
+        Packet *pkt = _arena.pop(q);
+        budget -= (int64_t)pkt->size();
+        _inputBytes[in] -= pkt->size();
+        _queued -= pkt->size();
+        pkt->sendOn();
+    } while (q.count > 0 && (int64_t)_arena.front(q)->size() <= budget);
+
+    if (q.count == 0) {
+        _requests[in].clear(out);
+        _requesters[out].clear(in);
+    }
+}
+
+void
+IqSwitch::doNextEvent()
+{
+    simtime_picosec now = EventList::Get().now();
+    if (_period > 0 && now >= _nextReport) {
+        printStats();
+        _peak = _queued;
+        _nextReport = now - now % _period + _period;
+    }
+
+    match();
+
+    _nSlots++;
+    _nMatches += _matches.size();
+    for (uint32_t in = 0; in < _inputs.size(); in++) {
+        if (_requests[in].any() && _freeInputs.test(in)) {
+            _nUnmatched++;
+        }
+    }
+
+    for (auto const &m : _matches) {
+        transfer(m.first, m.second);
+    }
+
+    // The fabric idles once every VOQ is empty.
+    if (_queued > 0) {
+        EventList::Get().sourceIsPendingRel(*this, _slot);
+    } else {
+        _running = false;
+    }
+}
+
+void
+IqSwitch::printStats()
+{
+#if MING_PROF
+    cout << str() << " " << timeAsUs(EventList::Get().now());
+#else
+    cout << str() << " " << timeAsMs(EventList::Get().now());
+#endif
+    cout << " iq voq " << _queued
+         << " peak " << _peak << " drops " << _nDrops << " slots " << _nSlots
+         << " matches " << _nMatches << " unmatched " << _nUnmatched << endl;
+}
@@ -0,0 +1,110 @@
+#ifndef IQ_SWITCH_H
+#define IQ_SWITCH_H
+
+/*
+ * An input-queued switch with a crossbar fabric.
+ *
+ * Each input keeps a virtual output queue (VOQ) per output, so a packet
+ * only waits behind packets for the same output. Every fabric slot the
+ * crossbar is matched with iSLIP: outputs grant round-robin among the
+ * inputs requesting them, inputs accept round-robin among their grants,
+ * and the pointers only move past an accepted grant in the first
+ * iteration. A matched input moves up to one MSS of packets to the egress
+ * queue of the output, at least one packet. A slot is one MSS at the
+ * fastest output speed over the speedup.
+ *
+ * Requests and grants are kept in bitmaps, so a match costs a few word
+ * operations per port. Inputs sit in routes just before the egress queue
+ * a packet leaves by, which is how the switch learns its output.
+ */
+
+#include "queue.h"
+#include "bitmap.h"
+#include "packetarena.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct IQcfg {
+    // Default values.
+    IQcfg() : iterations(1), speedup(1), inputBuffer(1024000), outputBuffer(2 * MSS_BYTES) {}
+
+    uint32_t iterations;    // iSLIP iterations per slot.
+    double speedup;         // Fabric speed over the fastest output.
+    mem_b inputBuffer;      // VOQ bytes per input.
+    mem_b outputBuffer;     // Egress bytes that stop the fabric serving an output, 0 for none.
+};
+
+class IqSwitch : public EventSource
+{
+public:
+    // Counters are reported every period while the fabric runs, 0 disables reporting.
+    IqSwitch(const std::string &name, struct IQcfg config = IQcfg(), simtime_picosec period = 0);
+
+    // Outputs must all be added before the first input.
+    void addOutput(Queue *queue);
+
+    // Adds an input, returns the sink its link delivers packets to.
+    PacketSink* addInput();
+
+    void receivePacket(uint32_t input, Packet &pkt);
+    void doNextEvent();
+    void printStats();
+
+private:
+    class Input : public PacketSink
+    {
+    public:
+        Input(IqSwitch &sw, uint32_t input) : _switch(sw), _input(input) {}
+        void receivePacket(Packet &pkt) { _switch.receivePacket(_input, pkt); }
+
+    private:
+        IqSwitch &_switch;
+        uint32_t _input;
+    };
+
+    inline PacketArena::Fifo& voq(uint32_t in, uint32_t out) {
+        return _voqs[in * _outputs.size() + out];
+    }
+
+    // iSLIP match of inputs to outputs for one slot.
+    void match();
+
+    // Moves up to one slot of packets from the head of a VOQ across the fabric.
+    void transfer(uint32_t in, uint32_t out);
+
+    struct IQcfg _cfg;
+    simtime_picosec _period;
+    simtime_picosec _slot;              // Fabric slot time.
+    bool _running;                      // A slot is scheduled.
+
+    std::vector<Queue*> _outputs;
+    std::unordered_map<PacketSink*, uint32_t> _outputIndex;
+    std::vector<Input*> _inputs;
+
+    PacketArena _arena;
+    std::vector<PacketArena::Fifo> _voqs;   // Input major.
+    std::vector<mem_b> _inputBytes;
+
+    std::vector<Bitmap> _requests;      // Per input, outputs with packets queued.
+    std::vector<Bitmap> _requesters;    // Per output, inputs with packets queued for it.
+    std::vector<Bitmap> _grants;        // Per input, outputs granting it this iteration.
+    std::vector<uint32_t> _grantPtr;    // Per output, input to grant first.
+    std::vector<uint32_t> _acceptPtr;   // Per input, output to accept first.
+    Bitmap _freeInputs;
+    Bitmap _freeOutputs;
+    std::vector<uint32_t> _granted;     // Inputs granted this iteration.
+    std::vector<std::pair<uint32_t, uint32_t>> _matches;
+
+    // Counters.
+    mem_b _queued;                      // Bytes in all VOQs.
+    mem_b _peak;                        // Peak VOQ bytes since the last report.
+    uint64_t _nDrops;
+    uint64_t _nSlots;
+    uint64_t _nMatches;
+    uint64_t _nUnmatched;               // Backlogged inputs left unmatched in a slot.
+    simtime_picosec _nextReport;
+};
+
+#endif
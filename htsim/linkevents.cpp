@@ -0,0 +1,157 @@
+#include "linkevents.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+LinkSchedule::LinkSchedule()
+    : EventSource("linkschedule"), _next(0)
+{
+}
+
+void
+LinkSchedule::addLink(const string &name,
+                      Queue *queue,
+                      Pipe *pipe)
+{
+    _links[name] = {queue, pipe, 0};
+}
+
+void
+LinkSchedule::parse(const string &events)
+{
+    string spec = events;
+    replace(spec.begin(), spec.end(), ';', '\n');
+
+    istringstream lines(spec);
+    string line;
+    while (getline(lines, line)) {
+        istringstream in(line);
+        double us;
+        string action;
+        Event e;
+
+        if (!(in >> us)) {
+            continue;
+        }
+        if (!(in >> e.link >> action)) {
+            cerr << "Bad link event: " << line << endl;
+            exit(1);
+        }
+
+        e.when = timeFromUs(us);
+        e.value = 0;
+        if (action == "down") {
+            e.action = Event::DOWN;
+        } else if (action == "up") {
+            e.action = Event::UP;
+        } else if ((action == "rate" || action == "delay") && (in >> e.value) && e.value > 0) {
+            e.action = (action == "rate") ? Event::RATE : Event::DELAY;
+        } else {
+            cerr << "Bad link event: " << line << endl;
+            exit(1);
+        }
+
+        string prefix = e.link;
+        bool wildcard = !prefix.empty() && prefix.back() == '*';
+        if (wildcard) {
+            prefix.pop_back();
+        }
+        auto it = _links.lower_bound(prefix);
+        if (it == _links.end() || (wildcard ? it->first.compare(0, prefix.size(), prefix) != 0
+                                            : it->first != prefix)) {
+            cerr << "Unknown link in event: " << line << endl;
+            exit(1);
+        }
+
+        _events.push_back(e);
+    }
+
+    stable_sort(_events.begin() + _next, _events.end(),
+                [](const Event &a, const Event &b) { return a.when < b.when; });
+    if (_next < _events.size()) {
+        EventList::Get().sourceIsPending(*this, max(_events[_next].when, EventList::Get().now()));
+    }
+}
+
+void
+LinkSchedule::load(const string &filename)
+{
+    ifstream file(filename);
+    if (!file) {
+        cerr << "Cannot read link events from " << filename << endl;
+        exit(1);
+    }
+
+    stringstream events;
+    events << file.rdbuf();
+    parse(events.str());
+}
+
+void
+LinkSchedule::doNextEvent()
+{
+    simtime_picosec now = EventList::Get().now();
+
+    // Parsing more than once may leave extra wakeups, they find nothing due.
+    if (_next >= _events.size() || _events[_next].when > now) {
+        return;
+    }
+
+    while (_next < _events.size() && _events[_next].when <= now) {
+        const Event &e = _events[_next++];
+
+        string prefix = e.link;
+        if (prefix.back() != '*') {
+            apply(e, prefix, _links[prefix]);
+            continue;
+        }
+
+        prefix.pop_back();
+        for (auto it = _links.lower_bound(prefix);
+             it != _links.end() && it->first.compare(0, prefix.size(), prefix) == 0; it++) {
+            apply(e, it->first, it->second);
+        }
+    }
+
+    if (_next < _events.size()) {
+        EventList::Get().sourceIsPending(*this, _events[_next].when);
+    }
+}
+
+void
+LinkSchedule::apply(const Event &e,
+                    const string &name,
+                    Link &link)
+{
+    cout << name << " " << timeAsMs(EventList::Get().now()) << " link ";
+
+    switch (e.action) {
+        case Event::DOWN:
+            // Packets in flight are lost by this failure too.
+            if (link.pipe->isUp()) {
+                link.dropsAtDown = link.pipe->_drops;
+            }
+            link.pipe->setUp(false);
+            cout << "down";
+            break;
+
+        case Event::UP:
+            link.pipe->setUp(true);
+            cout << "up lost " << link.pipe->_drops - link.dropsAtDown;
+            break;
+
+        case Event::RATE:
+            link.queue->setBitrate(speedFromGbps(e.value));
+            cout << "rate " << e.value;
+            break;
+
+        case Event::DELAY:
+            link.pipe->setDelay(timeFromUs(e.value));
+            cout << "delay " << e.value;
+            break;
+    }
+    cout << endl;
+}
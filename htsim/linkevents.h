@@ -0,0 +1,60 @@
+#ifndef LINK_EVENTS_H
+#define LINK_EVENTS_H
+
+/*
+ * Scheduled link failures, restores and changes of rate or delay. A link
+ * is the queue serializing onto it and the pipe carrying it, registered
+ * under a name. Events are given one per line or separated by ';', as
+ *
+ *   <time in us> <link> (down | up | rate <gbps> | delay <us>)
+ *
+ * A link name ending in '*' stands for every link it prefixes. A failed
+ * link loses what is in flight and all that reaches it until restored,
+ * its queue keeps draining into it.
+ */
+
+#include "eventlist.h"
+#include "queue.h"
+#include "pipe.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class LinkSchedule : public EventSource
+{
+public:
+    LinkSchedule();
+
+    void addLink(const std::string &name, Queue *queue, Pipe *pipe);
+
+    // Adds events, links must be added first. Exits on a bad event.
+    void parse(const std::string &events);
+    void load(const std::string &filename);
+
+    void doNextEvent();
+
+private:
+    struct Link {
+        Queue *queue;
+        Pipe *pipe;
+        uint64_t dropsAtDown;   // Pipe drops when the link last failed.
+    };
+
+    struct Event {
+        enum Action {DOWN, UP, RATE, DELAY};
+
+        simtime_picosec when;
+        std::string link;
+        Action action;
+        double value;
+    };
+
+    void apply(const Event &e, const std::string &name, Link &link);
+
+    std::map<std::string, Link> _links;   // Ordered, for prefixes.
+    std::vector<Event> _events;           // By time, from _next on pending.
+    size_t _next;
+};
+
+#endif
@@ -46,7 +46,7 @@ class TcpLoggerSimple : public Logger, public TcpLogger
                     tcp._cwnd, tcp._ssthresh, tcp._recover_seq);
 
             _logfile->writeRecord(TcpLogger::TCP_STATE, tcp.id, TcpLogger::TCPSTATE_SEQ,
-                    tcp._last_acked, tcp._highest_sent, tcp._RFC2988_RTO_timeout);
+                    tcp._last_acked, tcp._highest_sent, tcp.timer(DataSource::RTO));
         }
 };
 
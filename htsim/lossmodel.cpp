@@ -0,0 +1,58 @@
+#include "lossmodel.h"
+
+using namespace std;
+
+LossModel::LossModel()
+{
+    setRate(0);
+}
+
+void
+LossModel::setRate(double rate)
+{
+    _loss[GOOD] = _loss[BAD] = rate;
+    _leave[GOOD] = _leave[BAD] = 0;
+    enter(GOOD);
+}
+
+void
+LossModel::setGilbertElliott(double goodToBad,
+                             double badToGood,
+                             double lossGood,
+                             double lossBad)
+{
+    assert(goodToBad + badToGood > 0);
+
+    _loss[GOOD] = lossGood;
+    _loss[BAD] = lossBad;
+    _leave[GOOD] = goodToBad;
+    _leave[BAD] = badToGood;
+    enter(drand() < goodToBad / (goodToBad + badToGood) ? BAD : GOOD);
+}
+
+uint64_t
+LossModel::gap(double p)
+{
+    if (p <= 0) {
+        return NEVER;
+    }
+    if (p >= 1) {
+        return 0;
+    }
+
+    // Inverse transform, u in (0, 1] keeps the log finite.
+    double u = (rand() + 1.0) / ((double)RAND_MAX + 1.0);
+    double g = floor(log(u) / log1p(-p));
+    return (g < (double)NEVER) ? (uint64_t)g : NEVER;
+}
+
+void
+LossModel::enter(uint32_t state)
+{
+    _state = state;
+    _skip = gap(_loss[state]);
+
+    // At least the packet that follows is in the state.
+    uint64_t g = gap(_leave[state]);
+    _left = (g == NEVER) ? NEVER : g + 1;
+}
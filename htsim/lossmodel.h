@@ -0,0 +1,62 @@
+#ifndef LOSS_MODEL_H
+#define LOSS_MODEL_H
+
+/*
+ * Per-packet loss process of a link.
+ *
+ * Gilbert-Elliott: a good and a bad state, each losing packets with its
+ * own probability and left with its own probability after every packet.
+ * Independent losses are the good state alone. Rather than drawing a
+ * random number per packet, the gap to the next loss and the time left in
+ * a state are drawn from geometric distributions, so the generator only
+ * runs on a loss or a change of state.
+ */
+
+#include "htsim.h"
+
+class LossModel
+{
+public:
+    // No losses.
+    LossModel();
+
+    // Independent losses with probability rate per packet.
+    void setRate(double rate);
+
+    // Bursty losses. Starts in a state drawn from the steady state.
+    void setGilbertElliott(double goodToBad, double badToGood, double lossGood, double lossBad);
+
+    inline bool drop()
+    {
+        bool lost = (_skip == 0);
+        if (lost) {
+            _skip = gap(_loss[_state]);
+        } else {
+            _skip--;
+        }
+
+        if (--_left == 0) {
+            enter(1 - _state);
+        }
+        return lost;
+    }
+
+private:
+    enum { GOOD = 0, BAD = 1 };
+
+    static const uint64_t NEVER = UINT64_MAX;
+
+    // Trials before the first success, each succeeding with probability p.
+    static uint64_t gap(double p);
+
+    void enter(uint32_t state);
+
+    double _loss[2];    // Loss probability per packet, per state.
+    double _leave[2];   // Probability of leaving a state after a packet.
+
+    uint32_t _state;
+    uint64_t _skip;     // Packets to pass before the next loss.
+    uint64_t _left;     // Packets left in the state.
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "clock.h"
 #include "eventlist.h"
 #include "logfile.h"
+#include "queue.h"
 #include "test.h"
 
 using namespace std;
@@ -31,6 +32,10 @@ main(int argc,
         logpath = args["logfile"];
     }
 
+    // Queue stats go to <queueStats>.csv and <queueStats>-hist.csv at exit.
+    string statsPath = logpath + "-queues";
+    parseString(args, "queueStats", statsPath);
+
     uint32_t rngSeed = 1729;
     parseInt(args, "rngseed", rngSeed);
     srand(rngSeed);
@@ -55,6 +60,8 @@ main(int argc,
     Clock c;
     while (eventlist.doNextEvent()) {}
 
+    Queue::writeStats(statsPath + ".csv", statsPath + "-hist.csv");
+
     cerr << "\nExiting successfully!" << endl;
     return 0;
 }
@@ -42,6 +42,7 @@ class Packet
     mem_b size() const {return _size;}
     PacketFlow& flow() const {return *_flow;}
     inline packetid_t id() const {return _id;}
+    inline PacketSink* nextHop() const {return (*_route)[_nexthop];}
 
     inline void setFlag(PacketFlag flag) {_flags = _flags | (1 << flag);}
     inline void unsetFlag(PacketFlag flag) {_flags = _flags & ~(1 << flag);}
@@ -50,6 +51,10 @@ class Packet
     inline void setPriority(uint32_t p) {_priority = p;}
     inline uint32_t getPriority() {return _priority;}
 
+    // Time the packet joined the queue it is in.
+    inline simtime_picosec queuedAt() const {return _queuedAt;}
+    inline void setQueuedAt(simtime_picosec t) {_queuedAt = t;}
+
     protected:
     void set(PacketFlow &flow, route_t &route, mem_b pkt_size, packetid_t id);
 
@@ -62,6 +67,8 @@ class Packet
 
     uint32_t _flags;
     uint32_t _priority;
+
+    simtime_picosec _queuedAt;
 };
 
 class PacketFlow : public Logged
@@ -0,0 +1,157 @@
+#ifndef PACKET_ARENA_H
+#define PACKET_ARENA_H
+
+/*
+ * A shared pool of list nodes backing many packet FIFOs.
+ *
+ * Nodes are kept in one vector and recycled through a free list, so once
+ * the pool has grown to the peak occupancy, enqueue and dequeue do no heap
+ * allocation. A FIFO is just a head/tail pair of node indices into a
+ * doubly-linked list, so it can also be trimmed from the tail.
+ */
+
+#include "network.h"
+
+#include <vector>
+
+class PacketArena
+{
+public:
+    static const uint32_t NIL = 0xffffffff;
+
+    struct Fifo {
+        Fifo() : head(NIL), tail(NIL), count(0) {}
+        uint32_t head;
+        uint32_t tail;
+        uint32_t count;
+    };
+
+    PacketArena(uint32_t reserve = 0) : _free(NIL)
+    {
+        _nodes.reserve(reserve);
+    }
+
+    // Append a packet at the tail of a FIFO.
+    inline void push(Fifo &q, Packet *pkt)
+    {
+        uint32_t n = allocNode();
+        _nodes[n].pkt = pkt;
+        _nodes[n].next = NIL;
+        _nodes[n].prev = q.tail;
+
+        if (q.tail == NIL) {
+            q.head = n;
+        } else {
+            _nodes[q.tail].next = n;
+        }
+        q.tail = n;
+        q.count++;
+    }
+
+    // Packet at the head of a non-empty FIFO.
+    inline Packet* front(const Fifo &q) const
+    {
+        assert(q.head != NIL);
+        return _nodes[q.head].pkt;
+    }
+
+    // Remove and return the packet at the head of a non-empty FIFO.
+    inline Packet* pop(Fifo &q)
+    {
+        assert(q.head != NIL);
+        uint32_t n = q.head;
+        Packet *pkt = _nodes[n].pkt;
+
+        q.head = _nodes[n].next;
+        if (q.head == NIL) {
+            q.tail = NIL;
+        } else {
+            _nodes[q.head].prev = NIL;
+        }
+        q.count--;
+
+        freeNode(n);
+        return pkt;
+    }
+
+    // Packet at the tail of a non-empty FIFO.
+    inline Packet* back(const Fifo &q) const
+    {
+        assert(q.tail != NIL);
+        return _nodes[q.tail].pkt;
+    }
+
+    // Remove and return the packet at the tail of a non-empty FIFO.
+    inline Packet* popBack(Fifo &q)
+    {
+        assert(q.tail != NIL);
+        uint32_t n = q.tail;
+        Packet *pkt = _nodes[n].pkt;
+
+        q.tail = _nodes[n].prev;
+        if (q.tail == NIL) {
+            q.head = NIL;
+        } else {
+            _nodes[q.tail].next = NIL;
+        }
+        q.count--;
+
+        freeNode(n);
+        return pkt;
+    }
+
+    // Move all packets of src to the tail of dst, leaving src empty.
+    inline void append(Fifo &dst, Fifo &src)
+    {
+        if (src.head == NIL) {
+            return;
+        }
+        if (dst.tail == NIL) {
+            dst = src;
+        } else {
+            _nodes[dst.tail].next = src.head;
+            _nodes[src.head].prev = dst.tail;
+            dst.tail = src.tail;
+            dst.count += src.count;
+        }
+        src = Fifo();
+    }
+
+    // Calls f(pkt) for every packet in a FIFO, head first.
+    template<class F>
+    void forEach(const Fifo &q, F f) const
+    {
+        for (uint32_t n = q.head; n != NIL; n = _nodes[n].next) {
+            f(_nodes[n].pkt);
+        }
+    }
+
+private:
+    struct Node {
+        Packet *pkt;
+        uint32_t next;
+        uint32_t prev;
+    };
+
+    inline uint32_t allocNode()
+    {
+        if (_free != NIL) {
+            uint32_t n = _free;
+            _free = _nodes[n].next;
+            return n;
+        }
+        _nodes.push_back(Node());
+        return _nodes.size() - 1;
+    }
+
+    inline void freeNode(uint32_t n)
+    {
+        _nodes[n].next = _free;
+        _free = n;
+    }
+
+    std::vector<Node> _nodes;
+    uint32_t _free;
+};
+
+#endif /* PACKET_ARENA_H */
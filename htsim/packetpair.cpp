@@ -22,7 +22,6 @@ PacketPairSrc::PacketPairSrc(TrafficLogger *pktlogger,
       _min_rtt(ULLONG_MAX),
       _prev_rtt(0),
       _first_rto(0),
-      _rto_timeout(0),
       _last_rtt_update(0),
       _last_rtt_bytes(0),
       _measured_rate(0),
@@ -55,71 +54,76 @@ PacketPairSrc::printStatus()
 }
 
 void
-PacketPairSrc::doNextEvent()
+PacketPairSrc::onTimer(Timer timer)
 {
     simtime_picosec current_ts = EventList::Get().now();
 
     if (TRACE_FLOW == str()) {
-        printf("%s %.3lf EV %u %.3lf %.3lf\n",
-                str().c_str(), timeAsMs(current_ts), _state,
-                timeAsUs(_first_rto), timeAsUs(_rto_timeout));
-    }
-
-    // If this is the first transmission, send a packet-pair, set rto and return.
-    if (_state == IDLE || (_state == STARTUP && current_ts == _first_rto)) {
-        _highest_sent = 0;
-        _last_acked = 0;
-        _bdp_estimate = 2 * MSS_BYTES;
-        transmitPacketPair(current_ts);
-        _first_rto = current_ts + _rto;
-        _last_rtt_update = current_ts;
-        _state = STARTUP;
-        EventList::Get().sourceIsPendingRel(*this, _rto);
-        return;
-    }
-
-    // Cleanup the finished flow.
-    else if (_state == FINISH) {
-        if (_flow._nPackets == 0 && current_ts > _first_rto) {
-            delete _sink;
-            delete _route_fwd;
-            delete _route_rev;
-            delete this;
-            return;
-        }
-    }
-
-    // Retransmission timeout.
-    else if (_rto_timeout != 0 && current_ts >= _rto_timeout) {
-
-        cout << str() << " TMOUT " << timeAsMs(current_ts)
-             << " RTO " << timeAsUs(_rto)
-             << " MDEV " << timeAsUs(_mdev)
-             << " RTT "<< timeAsUs(_rtt)
-             << " SEQ " << _last_acked
-             << " RTO_timeout " << timeAsMs(_rto_timeout)
-             << " STATE " << _state << endl;
-
-        _recover_seq = _highest_sent;
-        _highest_sent = _last_acked + MSS_BYTES;
-        _dupacks = 0;
-        _state = NORMAL;
+        printf("%s %.3lf EV %u %u %.3lf %.3lf\n",
+                str().c_str(), timeAsMs(current_ts), _state, timer,
+                timeAsUs(_first_rto), timeAsUs(this->timer(RTO)));
+    }
+
+    switch (timer) {
+        // First transmission, or no reply to it within an rto: send a
+        // packet-pair and wait for it.
+        case START:
+            _highest_sent = 0;
+            _last_acked = 0;
+            _bdp_estimate = 2 * MSS_BYTES;
+            transmitPacketPair(current_ts);
+            _first_rto = current_ts + _rto;
+            _last_rtt_update = current_ts;
+            _state = STARTUP;
+            setTimer(START, _first_rto);
+            break;
+
+        case PACING:
+            sendPackets(current_ts);
+            break;
+
+        // Cleanup the finished flow.
+        case TEARDOWN:
+            if (_flow._nPackets == 0) {
+                delete _sink;
+                delete _route_fwd;
+                delete _route_rev;
+                delete this;
+                return;
+            }
+            // Keep checking till all packets have been drained.
+            setTimer(TEARDOWN, current_ts + (_rtt != 0 ? _rtt : timeFromUs(MIN_RTO_US)));
+            break;
+
+        // Retransmission timeout.
+        case RTO:
+            cout << str() << " TMOUT " << timeAsMs(current_ts)
+                 << " RTO " << timeAsUs(_rto)
+                 << " MDEV " << timeAsUs(_mdev)
+                 << " RTT "<< timeAsUs(_rtt)
+                 << " SEQ " << _last_acked
+                 << " RTO_timeout " << timeAsMs(current_ts)
+                 << " STATE " << _state << endl;
+
+            _recover_seq = _highest_sent;
+            _highest_sent = _last_acked + MSS_BYTES;
+            _dupacks = 0;
+            _state = NORMAL;
 
-        _rto *= 2;
-        _rto_timeout = current_ts + _rto;
+            _rto *= 2;
+            setTimer(RTO, current_ts + _rto);
+            cancelTimer(START);
 
-        retransmitPacket(current_ts);
-    }
+            retransmitPacket(current_ts);
 
-    if (current_ts == _first_rto) {
-        return;
-    }
+            // Pacing starts here if the flow timed out in startup.
+            if (!timerSet(PACING)) {
+                sendPackets(current_ts);
+            }
+            break;
 
-    if (_state != FINISH) {
-        sendPackets(current_ts);
-    } else {
-        // Keep scheduling till all packets have been drained.
-        EventList::Get().sourceIsPendingRel(*this, _rtt);
+        default:
+            break;
     }
 }
 
@@ -146,6 +150,10 @@ PacketPairSrc::receivePacket(Packet& pkt)
             _flowgen->finishFlow(id);
         }
         _state = FINISH;
+        cancelTimer(START);
+        cancelTimer(RTO);
+        cancelTimer(PACING);
+        setTimer(TEARDOWN, current_ts);
 
         cout << setprecision(6) << "Flow " << str() << " size " << _flowsize
              << " start " << lround(timeAsUs(_start_time)) << " end " << lround(timeAsUs(current_ts))
@@ -251,6 +259,7 @@ PacketPairSrc::receivePacket(Packet& pkt)
         // If this was the first estimate, start sending packets at estimated rate.
         if (_state == STARTUP) {
             _state = NORMAL;
+            cancelTimer(START);
             _pktpair_ewma = pktpairdiff;
             _rate_estimate = (MSS_BYTES * 8 * timeFromSec(1)) / pktpairdiff;
             _bdp_estimate = _rate_estimate * timeAsSec(_min_rtt) / 8;
@@ -283,9 +292,10 @@ PacketPairSrc::receivePacket(Packet& pkt)
         uint64_t bytes_acked = seqno - _last_acked;
         _last_acked = seqno;
 
-        _rto_timeout = current_ts + _rto;
         if (seqno == _highest_sent) {
-            _rto_timeout = 0;
+            cancelTimer(RTO);
+        } else {
+            setTimer(RTO, current_ts + _rto);
         }
 
         // Best behavior: new ack when we were expecting it.
@@ -350,7 +360,7 @@ PacketPairSrc::sendPackets(simtime_picosec current_ts)
     /* Schedule next transmission. Time to transmit 2*MSS_BYTES at estimated link rate. */
     simtime_picosec nextTransmission = timeFromSec((2.0 * MSS_BYTES * 8)/_rate_estimate);
 
-    EventList::Get().sourceIsPendingRel(*this, nextTransmission);
+    setTimer(PACING, current_ts + nextTransmission);
 }
 
 void
@@ -390,8 +400,8 @@ PacketPairSrc::transmitPacketPair(simtime_picosec current_ts)
     _highest_sent += MSS_BYTES;
     _packets_sent += MSS_BYTES;
 
-    if (_rto_timeout == 0) {
-        _rto_timeout = current_ts + _rto;
+    if (!timerSet(RTO)) {
+        setTimer(RTO, current_ts + _rto);
     }
 
     if (_flowsize != 0 && _highest_sent >= _flowsize) {
@@ -428,8 +438,8 @@ PacketPairSrc::retransmitPacket(simtime_picosec current_ts)
     _packets_sent += MSS_BYTES;
     p->sendOn();
 
-    if (_rto_timeout == 0) {
-        _rto_timeout = current_ts + _rto;
+    if (!timerSet(RTO)) {
+        setTimer(RTO, current_ts + _rto);
     }
 }
 
@@ -20,7 +20,6 @@ public:
             simtime_picosec duration = 0);
 
     void printStatus();
-    void doNextEvent();
     void receivePacket(Packet &pkt);
 
     // Flow status.
@@ -49,7 +48,7 @@ public:
     simtime_picosec _rtt, _rto, _mdev;
     simtime_picosec _min_rtt;
     simtime_picosec _prev_rtt;
-    simtime_picosec _first_rto, _rto_timeout;
+    simtime_picosec _first_rto;
 
     // Periodic RTT measurement variables (bw, ecn, ..)
     simtime_picosec _last_rtt_update;
@@ -61,6 +60,9 @@ public:
     uint32_t _marked_pkts;
     uint32_t _total_pkts;
 
+protected:
+    void onTimer(Timer timer);
+
 private:
     void sendPackets(simtime_picosec current_ts);
     void retransmitPacket(simtime_picosec current_ts);
@@ -0,0 +1,167 @@
+#include "pfc.h"
+
+using namespace std;
+
+PacketDB<PausePacket> PausePacket::_packetdb;
+
+PfcQueue::PfcQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct PFCcfg config)
+    : Queue(bitrate, maxsize, logger), _cfg(config), _pauseInput(*this),
+      _classes(config.nClasses), _currentPkt(NULL), _paused(config.nClasses, false),
+      _pausedSince(config.nClasses, 0), _pausedTime(config.nClasses, 0),
+      _nPauses(config.nClasses, 0), _nDrops(0)
+{
+    assert(_cfg.nClasses > 0);
+}
+
+void
+PfcQueue::beginService()
+{
+    assert(_currentPkt == NULL);
+
+    for (uint32_t c = _cfg.nClasses; c-- > 0; ) {
+        if (!_paused[c] && !_classes[c].empty()) {
+            _currentPkt = _classes[c].front();
+            _classes[c].pop_front();
+            EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+            return;
+        }
+    }
+}
+
+void
+PfcQueue::completeService()
+{
+    // Logging and cleanup.
+    _currentPkt->flow().logTraffic(*_currentPkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*_currentPkt, drainTime(_currentPkt));
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *_currentPkt);
+    }
+
+    applyEcnMark(*_currentPkt);
+    _queuesize -= _currentPkt->size();
+    _currentPkt->sendOn();
+    _currentPkt = NULL;
+
+    beginService();
+}
+
+void
+PfcQueue::receivePacket(Packet &pkt)
+{
+    // A lossless queue should never overflow, count it if it does.
+    if (_queuesize + pkt.size() > _maxsize) {
+        _nDrops++;
+        dropPacket(pkt);
+        return;
+    }
+
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
+
+    _classes[_cfg.classOf(pkt)].push_back(&pkt);
+    _stats.enqueue(pkt, _queuesize);
+    _queuesize += pkt.size();
+
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    }
+
+    if (_currentPkt == NULL) {
+        beginService();
+    }
+}
+
+void
+PfcQueue::pause(uint32_t cls, bool on)
+{
+    simtime_picosec now = EventList::Get().now();
+
+    if (on && !_paused[cls]) {
+        _paused[cls] = true;
+        _pausedSince[cls] = now;
+        _nPauses[cls]++;
+    } else if (!on && _paused[cls]) {
+        _paused[cls] = false;
+        _pausedTime[cls] += now - _pausedSince[cls];
+        if (_currentPkt == NULL) {
+            beginService();
+        }
+    }
+}
+
+void
+PfcQueue::PauseInput::receivePacket(Packet &pkt)
+{
+    PausePacket &p = static_cast<PausePacket&>(pkt);
+    _queue.pause(p.cls(), p.pause());
+    p.free();
+}
+
+void
+PfcQueue::printStats()
+{
+    Queue::printStats();
+
+    // Pause time so far and bytes held back by a pause, per class.
+    for (uint32_t c = 0; c < _cfg.nClasses; c++) {
+        if (_nPauses[c] == 0 && _nDrops == 0) {
+            continue;
+        }
+
+        simtime_picosec paused = _pausedTime[c];
+        mem_b blocked = 0;
+        if (_paused[c]) {
+            paused += EventList::Get().now() - _pausedSince[c];
+            for (auto pkt : _classes[c]) {
+                blocked += pkt->size();
+            }
+        }
+
+        printStatsPrefix();
+        cout << " pfc class " << c << " pauses " << _nPauses[c]
+             << " paused " << timeAsUs(paused) << " blocked " << blocked
+             << " drops " << _nDrops << endl;
+    }
+}
+
+PfcIngress::PfcIngress(Pipe *reverse, PfcQueue *upstream, struct PFCcfg config)
+    : _cfg(config), _release(*this), _flow(NULL), _bytes(config.nClasses, 0),
+      _xoff(config.nClasses, false)
+{
+    assert(_cfg.xon < _cfg.xoff);
+    _pauseRoute.push_back(reverse);
+    _pauseRoute.push_back(upstream->pauseInput());
+}
+
+void
+PfcIngress::sendPause(uint32_t cls, bool on)
+{
+    _xoff[cls] = on;
+    PausePacket::newpkt(_flow, _pauseRoute, cls, on)->sendOn();
+}
+
+void
+PfcIngress::receivePacket(Packet &pkt)
+{
+    uint32_t c = _cfg.classOf(pkt);
+    _bytes[c] += pkt.size();
+
+    if (!_xoff[c] && _bytes[c] >= _cfg.xoff) {
+        sendPause(c, true);
+    }
+    pkt.sendOn();
+}
+
+void
+PfcIngress::Release::receivePacket(Packet &pkt)
+{
+    PfcIngress &in = _ingress;
+    uint32_t c = in._cfg.classOf(pkt);
+    in._bytes[c] -= pkt.size();
+
+    if (in._xoff[c] && in._bytes[c] <= in._cfg.xon) {
+        in.sendPause(c, false);
+    }
+    pkt.sendOn();
+}
@@ -0,0 +1,149 @@
+#ifndef PFC_H
+#define PFC_H
+
+/*
+ * Priority flow control (802.1Qbb) for lossless fabrics.
+ *
+ * A switch accounts the bytes each of its input links holds, per priority
+ * class, from arrival until the packet leaves its egress queue. When a
+ * class goes over XOFF the switch sends a pause frame back over the
+ * reverse link, and the queue feeding the link stops serving that class
+ * once the frame arrives. Going back under XON sends a resume frame. The
+ * packet in transmission when a pause arrives is finished, as on a real
+ * link. Switch egress queues then need no buffer limit of their own.
+ */
+
+#include "queue.h"
+#include "pipe.h"
+
+#include <deque>
+#include <vector>
+
+struct PFCcfg {
+    // Default values.
+    PFCcfg() : nClasses(2), xoff(30000), xon(15000) {}
+
+    uint32_t nClasses;  // Priority classes, deadline packets in the highest.
+    mem_b xoff;         // Ingress bytes of a class that pause it upstream.
+    mem_b xon;          // Ingress bytes of a class that resume it.
+
+    // Class of a packet.
+    inline uint32_t classOf(Packet &pkt) const {
+        return pkt.getFlag(Packet::DEADLINE) ? nClasses - 1 : 0;
+    }
+};
+
+// Pause or resume frame for one class, reused from a packet pool.
+class PausePacket : public Packet
+{
+public:
+    static const mem_b SIZE = 64;
+
+    virtual ~PausePacket() {}
+
+    inline static PausePacket* newpkt(PacketFlow &flow, route_t &route, uint32_t cls, bool pause)
+    {
+        PausePacket *p = _packetdb.allocPacket();
+        p->set(flow, route, SIZE, 0);
+        p->_cls = cls;
+        p->_pause = pause;
+        return p;
+    }
+
+    void free() { _packetdb.freePacket(this); }
+
+    inline uint32_t cls() const { return _cls; }
+    inline bool pause() const { return _pause; }
+
+protected:
+    uint32_t _cls;
+    bool _pause;
+
+    static PacketDB<PausePacket> _packetdb;
+};
+
+/*
+ * Egress queue that can be paused per class. Classes are FIFOs served in
+ * strict priority, highest first, skipping paused classes.
+ */
+class PfcQueue : public Queue
+{
+public:
+    PfcQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct PFCcfg config = PFCcfg());
+    void receivePacket(Packet &pkt);
+    void printStats();
+
+    // Sink that pause frames for this queue are delivered to.
+    PacketSink* pauseInput() { return &_pauseInput; }
+
+    void pause(uint32_t cls, bool on);
+
+protected:
+    void beginService();
+    void completeService();
+
+private:
+    class PauseInput : public PacketSink
+    {
+    public:
+        PauseInput(PfcQueue &queue) : _queue(queue) {}
+        void receivePacket(Packet &pkt);
+
+    private:
+        PfcQueue &_queue;
+    };
+
+    struct PFCcfg _cfg;
+    PauseInput _pauseInput;
+    std::vector<std::deque<Packet*>> _classes;
+
+    // Current packet being serviced.
+    Packet *_currentPkt;
+
+    // Per class pause state and statistics.
+    std::vector<bool> _paused;
+    std::vector<simtime_picosec> _pausedSince;
+    std::vector<simtime_picosec> _pausedTime;   // Total time paused, until the last resume.
+    std::vector<uint64_t> _nPauses;
+    uint64_t _nDrops;
+};
+
+/*
+ * Ingress accounting of one switch input link. The ingress sits in routes
+ * after the link into the switch and its release sink after the egress
+ * queue, so it sees each packet enter and leave the switch.
+ */
+class PfcIngress : public PacketSink
+{
+public:
+    // Pause frames go out over the reverse link to the queue feeding this one.
+    PfcIngress(Pipe *reverse, PfcQueue *upstream, struct PFCcfg config = PFCcfg());
+    void receivePacket(Packet &pkt);
+
+    // Sink placed after the egress queue.
+    PacketSink* release() { return &_release; }
+
+private:
+    class Release : public PacketSink
+    {
+    public:
+        Release(PfcIngress &ingress) : _ingress(ingress) {}
+        void receivePacket(Packet &pkt);
+
+    private:
+        PfcIngress &_ingress;
+    };
+
+    void sendPause(uint32_t cls, bool on);
+
+    struct PFCcfg _cfg;
+    Release _release;
+    PacketFlow _flow;           // Flow of the pause frames.
+    route_t _pauseRoute;
+
+    std::vector<mem_b> _bytes;  // Bytes held per class.
+    std::vector<bool> _xoff;    // Class paused upstream.
+};
+
+#endif
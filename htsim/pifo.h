@@ -0,0 +1,145 @@
+#ifndef PIFO_H
+#define PIFO_H
+
+/*
+ * A push-in-first-out list of packets ordered by rank.
+ *
+ * Entries are kept in a bucketed sorted array: a deque of small sorted
+ * blocks. A push binary searches the blocks by their last rank and then
+ * the block itself, so it only ever shifts entries within one block.
+ * Both ends can be popped in O(1), the head to transmit and the tail to
+ * drop. Packets of equal rank leave in the order they were pushed.
+ */
+
+#include "network.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+class Pifo
+{
+public:
+    struct Entry {
+        uint64_t rank;
+        Packet *pkt;
+    };
+
+    Pifo(uint32_t blockSize = 64) : _blockSize(blockSize), _size(0)
+    {
+        assert(_blockSize >= 2);
+    }
+
+    // Insert a packet behind all packets of lower or equal rank.
+    void push(uint64_t rank, Packet *pkt)
+    {
+        Entry e = {rank, pkt};
+
+        // First block holding a higher rank, or the last block.
+        auto b = std::upper_bound(_blocks.begin(), _blocks.end(), rank,
+                [](uint64_t r, const Block &blk) { return r < blk.back().rank; });
+        if (b == _blocks.end()) {
+            if (_blocks.empty() || _blocks.back().live() >= _blockSize) {
+                _blocks.push_back(Block());
+                _blocks.back().entries.reserve(_blockSize + 1);
+            }
+            b = std::prev(_blocks.end());
+        }
+
+        // Popped entries at the front of the block are reclaimed first.
+        b->compact();
+        auto pos = std::upper_bound(b->entries.begin(), b->entries.end(), rank,
+                [](uint64_t r, const Entry &x) { return r < x.rank; });
+        b->entries.insert(pos, e);
+        _size++;
+
+        // Split a full block in two halves.
+        if (b->entries.size() > _blockSize) {
+            Block upper;
+            upper.entries.reserve(_blockSize + 1);
+            upper.entries.assign(b->entries.begin() + b->entries.size() / 2, b->entries.end());
+            b->entries.resize(b->entries.size() / 2);
+            _blocks.insert(std::next(b), std::move(upper));
+        }
+    }
+
+    // Entry with the lowest rank.
+    inline const Entry& front() const
+    {
+        assert(_size > 0);
+        return _blocks.front().front();
+    }
+
+    // Entry with the highest rank.
+    inline const Entry& back() const
+    {
+        assert(_size > 0);
+        return _blocks.back().back();
+    }
+
+    // Remove and return the entry with the lowest rank.
+    inline Entry pop()
+    {
+        Block &b = _blocks.front();
+        Entry e = b.front();
+        b.begin++;
+        if (b.live() == 0) {
+            _blocks.pop_front();
+        }
+        _size--;
+        return e;
+    }
+
+    // Remove and return the entry with the highest rank.
+    inline Entry popBack()
+    {
+        Block &b = _blocks.back();
+        Entry e = b.back();
+        b.entries.pop_back();
+        if (b.live() == 0) {
+            _blocks.pop_back();
+        }
+        _size--;
+        return e;
+    }
+
+    // Calls f(entry) for every entry, in rank order.
+    template<class F>
+    void forEach(F f) const
+    {
+        for (auto const &b : _blocks) {
+            for (uint32_t i = b.begin; i < b.entries.size(); i++) {
+                f(b.entries[i]);
+            }
+        }
+    }
+
+    inline uint32_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+
+private:
+    struct Block {
+        Block() : begin(0) {}
+
+        inline uint32_t live() const { return entries.size() - begin; }
+        inline const Entry& front() const { return entries[begin]; }
+        inline const Entry& back() const { return entries.back(); }
+
+        inline void compact()
+        {
+            if (begin > 0) {
+                entries.erase(entries.begin(), entries.begin() + begin);
+                begin = 0;
+            }
+        }
+
+        std::vector<Entry> entries;  // Sorted, live from begin onwards.
+        uint32_t begin;
+    };
+
+    std::deque<Block> _blocks;
+    uint32_t _blockSize;
+    uint32_t _size;
+};
+
+#endif /* PIFO_H */
@@ -0,0 +1,25 @@
+#include "pifoqueue.h"
+
+using namespace std;
+
+template class PifoQueue<SrptRank>;
+template class PifoQueue<StfqRank>;
+template class PifoQueue<EdfRank>;
+template class PifoQueue<LstfRank>;
+
+Queue*
+newPifoQueue(const string &rank, linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger)
+{
+    if (rank == SrptRank::name()) {
+        return new PifoQueue<SrptRank>(bitrate, maxsize, logger);
+    } else if (rank == StfqRank::name()) {
+        return new PifoQueue<StfqRank>(bitrate, maxsize, logger);
+    } else if (rank == EdfRank::name()) {
+        return new PifoQueue<EdfRank>(bitrate, maxsize, logger);
+    } else if (rank == LstfRank::name()) {
+        return new PifoQueue<LstfRank>(bitrate, maxsize, logger);
+    }
+
+    cerr << "Unknown pifo rank " << rank << endl;
+    exit(1);
+}
@@ -0,0 +1,292 @@
+#ifndef PIFO_QUEUE_H
+#define PIFO_QUEUE_H
+
+/*
+ * A programmable queue that drains packets in order of a rank computed at
+ * enqueue by a rank policy, chosen at compile time.
+ *
+ * A rank policy is a class providing:
+ *
+ *   struct FlowState;       Per-flow state, kept while the flow has packets
+ *                           queued. PER_FLOW is false if it is not needed.
+ *   static const char* name();
+ *   uint64_t rank(Packet &pkt, FlowState &fs, const Queue &q);
+ *                           Rank of an arriving packet, lower leaves first.
+ *   void dequeue(Packet &pkt, uint64_t rank);
+ *                           A packet is starting service.
+ *   void drop(Packet &pkt, uint64_t rank, FlowState &fs);
+ *                           A packet was pushed out of the tail.
+ *
+ * When the buffer overflows, the packet with the highest rank is dropped.
+ */
+
+#include "queue.h"
+#include "datapacket.h"
+#include "flowtable.h"
+#include "pifo.h"
+
+#include <string>
+
+/*
+ * Shortest remaining processing time. The sender stamps the bytes left in
+ * its flow into the packet priority (pFabric), see TcpSrc::_enable_pfabric.
+ */
+class SrptRank
+{
+public:
+    static const bool PER_FLOW = false;
+    struct FlowState {};
+
+    static const char* name() { return "srpt"; }
+
+    inline uint64_t rank(Packet &pkt, FlowState &, const Queue &)
+    {
+        return pkt.getPriority();
+    }
+
+    inline void dequeue(Packet &, uint64_t) {}
+    inline void drop(Packet &, uint64_t, FlowState &) {}
+};
+
+/*
+ * Start-time fair queueing. A packet is ranked by its virtual start time,
+ * the later of the virtual time and its flow's last finish time, and the
+ * virtual time is the start time of the packet in service.
+ */
+class StfqRank
+{
+public:
+    static const bool PER_FLOW = true;
+    struct FlowState {
+        FlowState() : finish(0) {}
+        uint64_t finish;    // Virtual finish time of the flow's last packet.
+    };
+
+    StfqRank() : _vtime(0) {}
+
+    static const char* name() { return "stfq"; }
+
+    inline uint64_t rank(Packet &pkt, FlowState &fs, const Queue &)
+    {
+        uint64_t start = std::max(_vtime, fs.finish);
+        fs.finish = start + pkt.size();
+        return start;
+    }
+
+    inline void dequeue(Packet &, uint64_t rank)
+    {
+        _vtime = rank;
+    }
+
+    inline void drop(Packet &, uint64_t rank, FlowState &fs)
+    {
+        // The tail packet is the flow's last one, take back its finish time.
+        fs.finish = rank;
+    }
+
+private:
+    uint64_t _vtime;
+};
+
+/*
+ * Earliest deadline first. Deadline packets are due at the time they were
+ * sent plus the slack the sender gave them, others are due on arrival.
+ */
+class EdfRank
+{
+public:
+    static const bool PER_FLOW = false;
+    struct FlowState {};
+
+    static const char* name() { return "edf"; }
+
+    inline uint64_t rank(Packet &pkt, FlowState &, const Queue &)
+    {
+        if (pkt.getFlag(Packet::DEADLINE)) {
+            DataPacket &p = static_cast<DataPacket&>(pkt);
+            return p.ts() + timeFromNs(pkt.getPriority());
+        }
+        return EventList::Get().now();
+    }
+
+    inline void dequeue(Packet &, uint64_t) {}
+    inline void drop(Packet &, uint64_t, FlowState &) {}
+};
+
+/*
+ * Least slack time first. Deadline packets are ranked by the time their
+ * slack runs out, arrival plus the slack they carry, others by arrival
+ * time. The time a packet waited here is charged against its slack when
+ * it leaves, so the next hop sees only the slack that is left.
+ */
+class LstfRank
+{
+public:
+    static const bool PER_FLOW = false;
+    struct FlowState {};
+
+    static const char* name() { return "lstf"; }
+
+    inline uint64_t rank(Packet &pkt, FlowState &, const Queue &)
+    {
+        simtime_picosec now = EventList::Get().now();
+        if (pkt.getFlag(Packet::DEADLINE)) {
+            return now + timeFromNs(pkt.getPriority());
+        }
+        return now;
+    }
+
+    inline void dequeue(Packet &pkt, uint64_t rank)
+    {
+        // Slack left is whatever the queueing delay did not use up.
+        if (pkt.getFlag(Packet::DEADLINE)) {
+            simtime_picosec now = EventList::Get().now();
+            pkt.setPriority(rank > now ? llround(timeAsNs(rank - now)) : 0);
+        }
+    }
+    inline void drop(Packet &, uint64_t, FlowState &) {}
+};
+
+template<class Rank>
+class PifoQueue : public Queue
+{
+public:
+    PifoQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger)
+        : Queue(bitrate, maxsize, logger), _currentPkt(NULL) {}
+
+    void receivePacket(Packet &pkt);
+
+protected:
+    void beginService();
+    void completeService();
+
+private:
+    struct FlowEntry {
+        FlowEntry() : nPackets(0) {}
+        uint32_t nPackets;                  // Packets of the flow in the queue.
+        typename Rank::FlowState state;
+    };
+
+    // Release one packet of a flow, forgetting the flow once it has none.
+    void releaseFlow(uint32_t flowid);
+
+    Rank _rank;
+    FlowTable<FlowEntry> _flows;
+    Pifo _pifo;
+
+    // Current packet being serviced.
+    Packet *_currentPkt;
+};
+
+// Creates a PIFO queue with the named rank policy (srpt/stfq/edf/lstf).
+Queue* newPifoQueue(const std::string &rank, linkspeed_bps bitrate, mem_b maxsize,
+        QueueLogger *logger);
+
+// Instantiated once, in pifoqueue.cpp.
+extern template class PifoQueue<SrptRank>;
+extern template class PifoQueue<StfqRank>;
+extern template class PifoQueue<EdfRank>;
+extern template class PifoQueue<LstfRank>;
+
+template<class Rank>
+void
+PifoQueue<Rank>::beginService()
+{
+    if (!_pifo.empty()) {
+        Pifo::Entry e = _pifo.pop();
+        _currentPkt = e.pkt;
+        _rank.dequeue(*_currentPkt, e.rank);
+
+        // Schedule it's completion time.
+        EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+    }
+}
+
+template<class Rank>
+void
+PifoQueue<Rank>::completeService()
+{
+    if (Rank::PER_FLOW) {
+        releaseFlow(_currentPkt->flow().id);
+    }
+
+    // Logging and cleanup.
+    _currentPkt->flow().logTraffic(*_currentPkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*_currentPkt, drainTime(_currentPkt));
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *_currentPkt);
+    }
+
+    applyEcnMark(*_currentPkt);
+    _currentPkt->sendOn();
+
+    // Clear packet being transmitted.
+    _queuesize -= _currentPkt->size();
+    _currentPkt = NULL;
+
+    beginService();
+}
+
+template<class Rank>
+void
+PifoQueue<Rank>::receivePacket(Packet &pkt)
+{
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
+    bool queueWasEmpty = (_currentPkt == NULL) && _pifo.empty();
+
+    uint64_t rank;
+    if (Rank::PER_FLOW) {
+        FlowEntry &fe = _flows[pkt.flow().id];
+        fe.nPackets++;
+        rank = _rank.rank(pkt, fe.state, *this);
+    } else {
+        typename Rank::FlowState none;
+        rank = _rank.rank(pkt, none, *this);
+    }
+
+    _pifo.push(rank, &pkt);
+    _stats.enqueue(pkt, _queuesize);
+    _queuesize += pkt.size();
+
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
+    }
+
+    // If we are over the queue limit, drop the highest ranked packets.
+    while (_queuesize > _maxsize) {
+        Pifo::Entry e = _pifo.popBack();
+        _queuesize -= e.pkt->size();
+        _stats.evict(*e.pkt);
+
+        if (Rank::PER_FLOW) {
+            uint32_t dropid = e.pkt->flow().id;
+            FlowEntry *fe = _flows.find(dropid);
+            if (fe != NULL) {
+                _rank.drop(*e.pkt, e.rank, fe->state);
+                releaseFlow(dropid);
+            }
+        }
+
+        dropPacket(*e.pkt);
+    }
+
+    if (queueWasEmpty && !_pifo.empty()) {
+        beginService();
+    }
+}
+
+template<class Rank>
+void
+PifoQueue<Rank>::releaseFlow(uint32_t flowid)
+{
+    FlowEntry *fe = _flows.find(flowid);
+    if (fe != NULL) {
+        if (fe->nPackets <= 1) {
+            _flows.erase(flowid);
+        } else {
+            fe->nPackets--;
+        }
+    }
+}
+
+#endif
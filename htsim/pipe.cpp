@@ -3,12 +3,17 @@
 using namespace std;
 
 Pipe::Pipe(simtime_picosec delay)
-    : EventSource("pipe"), _delay(delay)
+    : EventSource("pipe"), _drops(0), _delay(delay), _up(true)
 {}
 
 void
 Pipe::receivePacket(Packet &pkt)
 {
+    if (!_up) {
+        drop(pkt);
+        return;
+    }
+
     pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
 
     if (_inflight.empty()) {
@@ -23,7 +28,8 @@ Pipe::receivePacket(Packet &pkt)
 void
 Pipe::doNextEvent()
 {
-    if (_inflight.size() == 0) {
+    // Events left over from packets lost in a failure find nothing due.
+    if (_inflight.size() == 0 || _inflight.back().first > EventList::Get().now()) {
         return;
     }
 
@@ -33,8 +39,30 @@ Pipe::doNextEvent()
     pkt->sendOn();
 
     if (!_inflight.empty()) {
-        // notify the eventlist we've another event pending
-        simtime_picosec nexteventtime = _inflight.back().first;
+        // notify the eventlist we've another event pending, a packet
+        // that entered after a delay cut leaves right after the one ahead
+        simtime_picosec nexteventtime = max(_inflight.back().first, EventList::Get().now());
         EventList::Get().sourceIsPending(*this, nexteventtime);
     }
 }
+
+void
+Pipe::setUp(bool up)
+{
+    _up = up;
+    if (!up) {
+        while (!_inflight.empty()) {
+            Packet *pkt = _inflight.back().second;
+            _inflight.pop_back();
+            drop(*pkt);
+        }
+    }
+}
+
+void
+Pipe::drop(Packet &pkt)
+{
+    _drops++;
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
+    pkt.free();
+}
@@ -19,8 +19,20 @@ class Pipe : public EventSource, public PacketSink
         void doNextEvent(); // inherited from EventSource
         simtime_picosec delay() { return _delay; }
 
+        // Packets already in flight keep the delay they entered with.
+        void setDelay(simtime_picosec delay) { _delay = delay; }
+
+        // A failed pipe loses the packets in flight and all that arrive.
+        void setUp(bool up);
+        bool isUp() const { return _up; }
+
+        uint64_t _drops; // Packets lost while failed.
+
     private:
+        void drop(Packet &pkt);
+
         simtime_picosec _delay;
+        bool _up;
         typedef std::pair<simtime_picosec,Packet *> pktrecord_t;
         std::deque<pktrecord_t> _inflight; // the packets in flight (or being serialized)
 };
@@ -1,108 +1,109 @@
 #include "priorityqueue.h"
 
-#define TRACE_PKT 0 && 4304
-
 using namespace std;
 
-PriorityQueue::PriorityQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger)
-    : Queue(bitrate, maxsize, logger)
+PriorityQueue::PriorityQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+        struct PQcfg config)
+    : QueueT(bitrate, maxsize, logger)
 {
+    _scheduler.configure(config);
 }
 
 void
-PriorityQueue::beginService()
+PriorityScheduler::configure(const struct PQcfg &config)
 {
-    if (!_packets.empty()) {
-        // Remove packet from the queue for transmit.
-        _currentPkt = *_packets.begin();
-        _packets.erase(_packets.begin());
-
-        // Schedule it's completion time.
-        EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
-
-        if (TRACE_PKT == _currentPkt->flow().id) {
-            cout << str() << " Pkt depart sched " << EventList::Get().now() << " "
-                 << _currentPkt->id() << " " << _packets.size() << " " << drainTime(_currentPkt)
-                 << " " << _currentPkt->size() << " " << _ps_per_byte << endl;
+    _cfg = config;
+    if (_cfg.nLevels > 0) {
+        _levels = vector<PacketArena::Fifo>(_cfg.nLevels);
+        _busy.resize(_cfg.nLevels);
+        if (_cfg.levelWidth == 0) {
+            _cfg.levelWidth = 1;
         }
     }
 }
 
 void
-PriorityQueue::completeService()
+PriorityScheduler::bucketInsert(Packet *pkt)
 {
-    // Logging and cleanup.
-    _currentPkt->flow().logTraffic(*_currentPkt, *this, TrafficLogger::PKT_DEPART);
-    if (_logger) {
-        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *_currentPkt);
-    }
+    age();
 
-    if (TRACE_PKT == _currentPkt->flow().id) {
-        cout << str() << " Pkt depart " << EventList::Get().now() << " " << _currentPkt->id()
-             << " " << _currentPkt->size() << " " << _packets.size() << endl;
+    uint32_t level = pkt->getPriority() / _cfg.levelWidth;
+    if (level >= _cfg.nLevels) {
+        level = _cfg.nLevels - 1;
     }
 
-    applyEcnMark(*_currentPkt);
-    _currentPkt->sendOn();
-
-    // Clear packet being transmitted.
-    _queuesize -= _currentPkt->size();
-    _currentPkt = NULL;
-
-    beginService();
+    uint32_t phys = physLevel(level);
+    _arena.push(_levels[phys], pkt);
+    _busy.set(phys);
+    _nPackets++;
 }
 
-void
-PriorityQueue::receivePacket(Packet& pkt) 
+Packet*
+PriorityScheduler::bucketPopHighest()
 {
-    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
-    bool queueWasEmpty = (_currentPkt == NULL) && _packets.empty();
-
-    if (TRACE_PKT == pkt.flow().id) {
-        cout << str() << " Pkt arrive " << EventList::Get().now() << " " << pkt.id() << " " << pkt.size() << " " << _packets.size() << endl;
-    }
-
-    _packets.insert(&pkt);
-    _queuesize += pkt.size();
+    age();
 
-    if (_logger) {
-        _logger->logQueue(*this, QueueLogger::PKT_ENQUEUE, pkt);
-    }
-
-    // If we are over the queue limit, drop packets from the end.
-    while (_queuesize > _maxsize) {
-        Packet *p = *prev(_packets.end());
-        _packets.erase(prev(_packets.end()));
-        _queuesize -= p->size();
+    // Levels are a ring starting at _base, so search forward from there.
+    uint32_t phys = _busy.findNextCyclic(_base);
+    assert(phys != Bitmap::NONE);
 
-        if (_logger) {
-            _logger->logQueue(*this, QueueLogger::PKT_DROP, *p);
-        }
-        p->flow().logTraffic(*p, *this, TrafficLogger::PKT_DROP);
-        p->free();
+    Packet *pkt = _arena.pop(_levels[phys]);
+    if (_levels[phys].count == 0) {
+        _busy.clear(phys);
     }
+    _nPackets--;
+    return pkt;
+}
 
-    if (queueWasEmpty) {
-        beginService();
+Packet*
+PriorityScheduler::bucketPopLowest()
+{
+    // Lowest level is just before _base in the ring, drop its newest packet.
+    uint32_t last = physLevel(_cfg.nLevels - 1);
+    uint32_t phys = _busy.findPrevCyclic(last);
+    assert(phys != Bitmap::NONE);
+
+    Packet *pkt = _arena.popBack(_levels[phys]);
+    if (_levels[phys].count == 0) {
+        _busy.clear(phys);
     }
+    _nPackets--;
+    return pkt;
 }
 
 void
-PriorityQueue::printStats()
+PriorityScheduler::age()
 {
-    unordered_map<uint32_t, uint32_t> counts;
+    if (_cfg.agingPeriod == 0 || _cfg.nLevels < 2) {
+        return;
+    }
+
+    simtime_picosec now = EventList::Get().now();
+    if (_nPackets == 0) {
+        _lastAging = now;
+        return;
+    }
 
-    for (auto const& i : _packets) {
-        uint32_t fid = i->flow().id;
-        if (counts.find(fid) == counts.end()) {
-            counts[fid] = 0;
+    // After nLevels periods everything is at the top level anyway.
+    uint32_t steps = 0;
+    while (now - _lastAging >= _cfg.agingPeriod && steps < _cfg.nLevels) {
+        _lastAging += _cfg.agingPeriod;
+        steps++;
+
+        // Merge level 1 behind level 0, then rotate the ring by one so every
+        // other level moves up and the emptied slot becomes the lowest level.
+        uint32_t top = _base;
+        uint32_t next = physLevel(1);
+        _arena.append(_levels[top], _levels[next]);
+        std::swap(_levels[top], _levels[next]);
+        _busy.clear(top);
+        if (_levels[next].count > 0) {
+            _busy.set(next);
         }
-        counts[fid] = counts[fid] + 1;
+        _base = next;
     }
 
-    cout << str() << " stats ";
-    for (auto it = counts.begin(); it != counts.end(); it++) {
-        cout << " " << it->second;
+    if (now - _lastAging >= _cfg.agingPeriod) {
+        _lastAging = now;
     }
-    cout << endl;
 }
@@ -3,9 +3,17 @@
 
 /*
  * A priority-queue that drains packets based on their priority.
+ *
+ * By default packets are kept exactly ordered in a multi-set. With nLevels
+ * set, priorities are quantized into a bucket queue instead: one FIFO per
+ * level and an occupancy bitmap, for O(1) enqueue, dequeue and drop of the
+ * lowest priority packet. Optional aging moves every waiting packet up one
+ * level per aging period so low priority packets cannot starve forever.
  */
 
-#include "queue.h"
+#include "queuet.h"
+#include "bitmap.h"
+#include "packetarena.h"
 
 #include <set>
 
@@ -22,23 +30,88 @@ public:
     }
 };
 
-class PriorityQueue : public Queue
+struct PQcfg {
+    // Default values.
+    PQcfg() : nLevels(0), levelWidth(1), agingPeriod(0) {}
+
+    uint32_t nLevels;             // Priority levels, 0 keeps exact ordering.
+    uint32_t levelWidth;          // Priority values per level.
+    simtime_picosec agingPeriod;  // Time a packet waits to move up a level, 0 disables aging.
+};
+
+/*
+ * Scheduler of the priority queue, draining the highest priority packet
+ * first and pushing out the lowest.
+ */
+class PriorityScheduler
 {
 public:
-    PriorityQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger);
-    void receivePacket(Packet &pkt);
-    void printStats();
+    PriorityScheduler() : _base(0), _nPackets(0), _lastAging(0) {}
+    void configure(const struct PQcfg &config);
 
-protected:
-    void beginService();
-    void completeService();
+    inline bool empty() const { return _packets.empty() && _nPackets == 0; }
+    inline void complete(Packet &) {}
+
+    inline void push(Packet &pkt)
+    {
+        if (_cfg.nLevels > 0) {
+            bucketInsert(&pkt);
+        } else {
+            _packets.insert(&pkt);
+        }
+    }
+
+    inline Packet* pop()
+    {
+        if (_cfg.nLevels > 0) {
+            return bucketPopHighest();
+        }
+        Packet *pkt = *_packets.begin();
+        _packets.erase(_packets.begin());
+        return pkt;
+    }
+
+    inline Packet* evict()
+    {
+        if (_cfg.nLevels > 0) {
+            return bucketPopLowest();
+        }
+        Packet *pkt = *std::prev(_packets.end());
+        _packets.erase(std::prev(_packets.end()));
+        return pkt;
+    }
 
 private:
+    // Bucket queue operations.
+    inline uint32_t physLevel(uint32_t level) {
+        level += _base;
+        return level >= _cfg.nLevels ? level - _cfg.nLevels : level;
+    }
+    void bucketInsert(Packet *pkt);
+    Packet* bucketPopHighest();
+    Packet* bucketPopLowest();
+    void age();
+
+    // Priority queue parameters.
+    struct PQcfg _cfg;
+
     // Multi-set of all packets, to transmit from head or drop from tail.
     std::multiset<Packet*, ComparePacketPriority> _packets;
 
-    // Current packet being serviced.
-    Packet *_currentPkt;
+    // Bucket queue, a ring of per-level FIFOs starting at _base.
+    PacketArena _arena;
+    std::vector<PacketArena::Fifo> _levels;
+    Bitmap _busy;
+    uint32_t _base;
+    uint64_t _nPackets;
+    simtime_picosec _lastAging;
+};
+
+class PriorityQueue : public QueueT<PriorityScheduler, PushOut, DctcpEcn, QueueLogging>
+{
+public:
+    PriorityQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger,
+            struct PQcfg config = PQcfg());
 };
 
 #endif
@@ -4,8 +4,13 @@
 #include "queue.h"
 #include "prof.h"
 
+#include <algorithm>
+#include <map>
+
 using namespace std;
 
+vector<Queue*> Queue::_all;
+
 Queue::Queue(linkspeed_bps bitrate, 
              mem_b maxsize, 
              QueueLogger* logger)
@@ -16,6 +21,19 @@ Queue::Queue(linkspeed_bps bitrate,
              _logger(logger)
 {
     _ps_per_byte = (simtime_picosec)(8 * 1000000000000UL / _bitrate);
+    _all.push_back(this);
+}
+
+void
+Queue::setBitrate(linkspeed_bps bitrate)
+{
+    _bitrate = bitrate;
+    _ps_per_byte = (simtime_picosec)(8 * 1000000000000UL / _bitrate);
+}
+
+Queue::~Queue()
+{
+    _all.erase(find(_all.begin(), _all.end(), this));
 }
 
 void
@@ -35,6 +53,7 @@ Queue::completeService()
     _queuesize -= pkt->size();
 
     pkt->flow().logTraffic(*pkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*pkt, drainTime(pkt));
 
     if (_logger) {
         _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *pkt);
@@ -58,11 +77,7 @@ void
 Queue::receivePacket(Packet &pkt) 
 {
     if (_queuesize + pkt.size() > _maxsize) {
-        if (_logger) {
-            _logger->logQueue(*this, QueueLogger::PKT_DROP, pkt);
-        }
-        pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
-        pkt.free();
+        dropPacket(pkt);
         return;
     }
 
@@ -70,6 +85,7 @@ Queue::receivePacket(Packet &pkt)
 
     bool queueWasEmpty = _enqueued.empty();
     _enqueued.push_front(&pkt);
+    _stats.enqueue(pkt, _queuesize);
     _queuesize += pkt.size();
 
     if (_logger) {
@@ -82,35 +98,142 @@ Queue::receivePacket(Packet &pkt)
     }
 }
 
+void
+Queue::dropPacket(Packet &pkt)
+{
+    _stats.drop(pkt);
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_DROP, pkt);
+    }
+    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
+    pkt.free();
+}
+
 void
 Queue::applyEcnMark(Packet &pkt)
 {
     if (ENABLE_ECN && _queuesize > dctcpThreshold()) {
-        pkt.setFlag(Packet::ECN_FWD);
+        _stats.mark(pkt);
     }
 }
 
 void
 Queue::printStats()
 {
-    unordered_map<uint32_t, uint32_t> counts;
-
-    for (auto const& i : _enqueued) {
-        uint32_t fid = i->flow().id;
-        if (counts.find(fid) == counts.end()) {
-            counts[fid] = 0;
-        }
-        counts[fid] = counts[fid] + 1;
-    }
+    printStatsPrefix();
+    cout << " stats";
+    printTopFlows();
+    cout << endl;
+}
 
+void
+Queue::printStatsPrefix()
+{
 #if MING_PROF
-    cout << str() << " " << timeAsUs(EventList::Get().now()) << " stats";
+    cout << str() << " " << timeAsUs(EventList::Get().now());
 #else
-    cout << str() << " " << timeAsMs(EventList::Get().now()) << " stats";
+    cout << str() << " " << timeAsMs(EventList::Get().now());
 #endif
+}
+
+void
+Queue::printTopFlows()
+{
+    _stats.flows.report([](uint32_t flowid, uint32_t packets) {
+        cout << " " << flowid << "->" << packets;
+    });
+}
+
+// Name of a queue without its trailing numeric fields.
+static string
+statsGroup(const string &name)
+{
+    size_t end = name.size();
+    while (end > 0) {
+        size_t dash = name.rfind('-', end - 1);
+        if (dash == string::npos || dash + 1 == end ||
+            name.find_first_not_of("0123456789", dash + 1) < end) {
+            break;
+        }
+        end = dash;
+    }
+    return name.substr(0, end);
+}
 
-    for (auto it = counts.begin(); it != counts.end(); it++) {
-        cout << " " << it->first << "->" << it->second;
+static void
+writeSummary(FILE *fp, const string &group, const string &queue, const QueueStats &s)
+{
+    fprintf(fp, "%s,%s,%lu,%lu,%lu,%lu,%lu", group.c_str(), queue.c_str(),
+            s.nEnqueues, s.nBytes, s.nDrops, s.nDropBytes, s.nMarks);
+    for (const Histogram *h : {&s.occupancy, &s.sojourn}) {
+        fprintf(fp, ",%lu,%lu,%lu,%lu", h->percentile(0.5), h->percentile(0.99),
+                h->percentile(0.999), h->max());
     }
-    cout << endl;
+    fprintf(fp, "\n");
+}
+
+static void
+writeHistograms(FILE *fp, const string &group, const string &queue, const QueueStats &s)
+{
+    const char *metric[] = {"occupancy", "sojourn"};
+    const Histogram *hist[] = {&s.occupancy, &s.sojourn};
+
+    for (int m = 0; m < 2; m++) {
+        for (uint32_t b = 0; b < Histogram::NBUCKETS; b++) {
+            if (hist[m]->count(b) > 0) {
+                fprintf(fp, "%s,%s,%s,%lu,%lu,%lu\n", group.c_str(), queue.c_str(), metric[m],
+                        Histogram::lowest(b), Histogram::highest(b), hist[m]->count(b));
+            }
+        }
+    }
+}
+
+void
+Queue::writeStats(const string &summaryPath,
+                  const string &histPath)
+{
+    FILE *summary = fopen(summaryPath.c_str(), "w");
+    FILE *hist = fopen(histPath.c_str(), "w");
+    if (summary == NULL || hist == NULL) {
+        cerr << "Cannot write queue stats to " << summaryPath << endl;
+        if (summary) {
+            fclose(summary);
+        }
+        if (hist) {
+            fclose(hist);
+        }
+        return;
+    }
+
+    fprintf(summary, "group,queue,enqueues,bytes,drops,drop_bytes,marks,"
+            "occ_p50,occ_p99,occ_p999,occ_max,"
+            "sojourn_p50_ns,sojourn_p99_ns,sojourn_p999_ns,sojourn_max_ns\n");
+    fprintf(hist, "group,queue,metric,low,high,count\n");
+
+    // Idle queues are left out, groups are listed in order of first use.
+    vector<string> order;
+    map<string, QueueStats> groups;
+
+    for (Queue *q : _all) {
+        if (q->_stats.nEnqueues == 0 && q->_stats.nDrops == 0) {
+            continue;
+        }
+
+        string group = statsGroup(q->str());
+        if (groups.find(group) == groups.end()) {
+            order.push_back(group);
+        }
+        groups[group].merge(q->_stats);
+
+        writeSummary(summary, group, q->str(), q->_stats);
+        writeHistograms(hist, group, q->str(), q->_stats);
+    }
+
+    for (auto const &group : order) {
+        writeSummary(summary, group, "*", groups[group]);
+        writeHistograms(hist, group, "*", groups[group]);
+    }
+
+    fclose(summary);
+    fclose(hist);
 }
@@ -7,17 +7,27 @@
 #include "eventlist.h"
 #include "network.h"
 #include "loggertypes.h"
+#include "queuestats.h"
 
 #include <list>
+#include <vector>
 
 class Queue : public EventSource, public PacketSink
 {
     public:
         Queue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger);
+        virtual ~Queue();
         void doNextEvent();
         virtual void receivePacket(Packet &pkt);
         virtual void printStats();
 
+        inline linkspeed_bps bitrate() const {
+            return _bitrate;
+        }
+
+        // The packet being sent finishes at the old rate.
+        void setBitrate(linkspeed_bps bitrate);
+
         inline simtime_picosec drainTime(Packet *pkt) {
             return (simtime_picosec)(pkt->size()) * _ps_per_byte;
         }
@@ -38,6 +48,11 @@ class Queue : public EventSource, public PacketSink
 
         mem_b _maxsize;   // Maximum queue size.
         mem_b _queuesize; // Current queue size.
+        QueueStats _stats;
+
+        // Writes the stats of every queue, and of each group of queues named
+        // alike but for trailing numbers, as CSV summary and histograms.
+        static void writeStats(const std::string &summaryPath, const std::string &histPath);
 
     protected:
         // Start serving the item at the head of the queue.
@@ -49,12 +64,25 @@ class Queue : public EventSource, public PacketSink
         // Apply ECN marking.
         void applyEcnMark(Packet &pkt);
 
+        // Log and free a dropped packet.
+        void dropPacket(Packet &pkt);
+
+        // Starts a stats line with the queue name and the time, in us when
+        // profiling.
+        void printStatsPrefix();
+
+        // Prints the heaviest flows queued, as flow->packets.
+        void printTopFlows();
+
         std::list<Packet*> _enqueued;  // List of packet enqueued.
         linkspeed_bps _bitrate;       // Speed at which queue drains.
         simtime_picosec _ps_per_byte; // Service time, in picosec per byte.
 
         // Housekeeping
         QueueLogger *_logger;
+
+    private:
+        static std::vector<Queue*> _all;
 };
 
 #endif /* QUEUE_H */
@@ -0,0 +1,260 @@
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+/*
+ * Always-on queue instrumentation: counters, histograms of the occupancy
+ * arriving packets find and of the time packets wait before their
+ * transmission starts, and packets queued per flow.
+ */
+
+#include "eventlist.h"
+#include "network.h"
+#include "flowtable.h"
+
+#include <algorithm>
+
+/*
+ * Log-linear histogram of non-negative integers, as in HdrHistogram.
+ * Values below 2^SUB_BITS get a bucket each, every power of two above is
+ * split into 2^(SUB_BITS-1) buckets, so a bucket spans at most 1/16 of its
+ * values. Values from 2^MAX_BITS up share the last bucket.
+ */
+class Histogram
+{
+public:
+    static const uint32_t SUB_BITS = 5;
+    static const uint32_t MAX_BITS = 40;
+    static const uint32_t HALF = 1 << (SUB_BITS - 1);
+    static const uint32_t NBUCKETS = (1 << SUB_BITS) + (MAX_BITS - SUB_BITS) * HALF;
+
+    Histogram() : _buckets(), _count(0), _max(0) {}
+
+    inline void record(uint64_t v)
+    {
+        _buckets[bucket(v)]++;
+        _count++;
+        _max = std::max(_max, v);
+    }
+
+    void merge(const Histogram &h)
+    {
+        for (uint32_t b = 0; b < NBUCKETS; b++) {
+            _buckets[b] += h._buckets[b];
+        }
+        _count += h._count;
+        _max = std::max(_max, h._max);
+    }
+
+    // Highest value of the bucket holding the q quantile, at most the max.
+    uint64_t percentile(double q) const
+    {
+        uint64_t rank = (uint64_t)ceil(q * _count);
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < NBUCKETS; b++) {
+            seen += _buckets[b];
+            if (seen >= rank && seen > 0) {
+                return std::min(highest(b), _max);
+            }
+        }
+        return _max;
+    }
+
+    static inline uint32_t bucket(uint64_t v)
+    {
+        if (v < (1ULL << SUB_BITS)) {
+            return v;
+        }
+        uint32_t shift = 63 - __builtin_clzll(v) - SUB_BITS + 1;
+        uint32_t b = (1 << SUB_BITS) + (shift - 1) * HALF + (uint32_t)((v >> shift) - HALF);
+        return std::min(b, NBUCKETS - 1);
+    }
+
+    static inline uint64_t lowest(uint32_t b)
+    {
+        if (b < (1U << SUB_BITS)) {
+            return b;
+        }
+        uint32_t shift = (b - (1 << SUB_BITS)) / HALF + 1;
+        return (uint64_t)((b - (1 << SUB_BITS)) % HALF + HALF) << shift;
+    }
+
+    static inline uint64_t highest(uint32_t b) { return lowest(b + 1) - 1; }
+
+    inline uint64_t count() const { return _count; }
+    inline uint64_t count(uint32_t b) const { return _buckets[b]; }
+    inline uint64_t max() const { return _max; }
+
+private:
+    uint64_t _buckets[NBUCKETS];
+    uint64_t _count;
+    uint64_t _max;
+};
+
+/*
+ * Packets queued per flow, kept up to date on enqueue and departure, and
+ * the flows that arrive most by space-saving (Metwally et al.): K
+ * counters, and an untracked flow takes over the smallest counter plus
+ * one, so a flow with more than 1/K of the arrivals is always tracked.
+ * Counters halve at each report to follow recent arrivals.
+ */
+class FlowOccupancy
+{
+public:
+    static const uint32_t K = 10;
+
+    FlowOccupancy() : _nTop(0) {}
+
+    inline void add(Packet &pkt)
+    {
+        uint32_t flowid = pkt.flow().id;
+        _packets[flowid]++;
+        offer(flowid);
+    }
+
+    inline void remove(Packet &pkt)
+    {
+        uint32_t flowid = pkt.flow().id;
+        uint32_t *n = _packets.find(flowid);
+        if (--*n == 0) {
+            _packets.erase(flowid);
+        }
+    }
+
+    inline uint32_t packets(uint32_t flowid)
+    {
+        uint32_t *n = _packets.find(flowid);
+        return n ? *n : 0;
+    }
+
+    // Calls f(flow id, packets) for tracked flows with packets queued, most first.
+    template<class F>
+    void report(F f)
+    {
+        std::pair<uint32_t, uint32_t> queued[K];
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < _nTop; i++) {
+            uint32_t p = packets(_top[i].flowid);
+            _top[i].count /= 2;
+            if (p == 0) {
+                continue;
+            }
+
+            // Insertion sort, K is small.
+            uint32_t j = n++;
+            for (; j > 0 && queued[j - 1].first < p; j--) {
+                queued[j] = queued[j - 1];
+            }
+            queued[j] = std::make_pair(p, _top[i].flowid);
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            f(queued[i].second, queued[i].first);
+        }
+    }
+
+private:
+    inline void offer(uint32_t flowid)
+    {
+        uint32_t min = 0;
+        for (uint32_t i = 0; i < _nTop; i++) {
+            if (_top[i].flowid == flowid) {
+                _top[i].count++;
+                return;
+            }
+            if (_top[i].count < _top[min].count) {
+                min = i;
+            }
+        }
+
+        if (_nTop < K) {
+            min = _nTop++;
+            _top[min].count = 0;
+        }
+        _top[min].flowid = flowid;
+        _top[min].count++;
+    }
+
+    struct Counter {
+        uint32_t flowid;
+        uint64_t count;     // Arrivals, over-estimated by the count taken over.
+    };
+
+    FlowTable<uint32_t> _packets;
+    Counter _top[K];
+    uint32_t _nTop;
+};
+
+class QueueStats
+{
+public:
+    QueueStats() : nEnqueues(0), nBytes(0), nDrops(0), nDropBytes(0), nMarks(0) {}
+
+    // A packet joins the queue behind queued bytes.
+    inline void enqueue(Packet &pkt, mem_b queued)
+    {
+        nEnqueues++;
+        nBytes += pkt.size();
+        occupancy.record(queued);
+        flows.add(pkt);
+        pkt.setQueuedAt(EventList::Get().now());
+    }
+
+    // A packet has been sent, taking service time on the link.
+    inline void depart(Packet &pkt, simtime_picosec service)
+    {
+        departFront(pkt, service);
+        flows.remove(pkt);
+    }
+
+    // The front of a queued packet has been sent on its own, the rest stays.
+    inline void departFront(Packet &front, simtime_picosec service)
+    {
+        simtime_picosec stay = EventList::Get().now() - front.queuedAt();
+        sojourn.record(stay > service ? (stay - service) / 1000 : 0);
+    }
+
+    // A queued packet is pushed out, drop() counts it.
+    inline void evict(Packet &pkt)
+    {
+        flows.remove(pkt);
+    }
+
+    inline void drop(Packet &pkt)
+    {
+        nDrops++;
+        nDropBytes += pkt.size();
+    }
+
+    // Sets ECN, counting packets not marked before.
+    inline void mark(Packet &pkt)
+    {
+        if (!pkt.getFlag(Packet::ECN_FWD)) {
+            pkt.setFlag(Packet::ECN_FWD);
+            nMarks++;
+        }
+    }
+
+    void merge(const QueueStats &s)
+    {
+        nEnqueues += s.nEnqueues;
+        nBytes += s.nBytes;
+        nDrops += s.nDrops;
+        nDropBytes += s.nDropBytes;
+        nMarks += s.nMarks;
+        occupancy.merge(s.occupancy);
+        sojourn.merge(s.sojourn);
+    }
+
+    uint64_t nEnqueues;
+    uint64_t nBytes;        // Bytes enqueued.
+    uint64_t nDrops;
+    uint64_t nDropBytes;
+    uint64_t nMarks;        // Packets this queue marked with ECN.
+
+    Histogram occupancy;    // Bytes queued ahead of each arrival.
+    Histogram sojourn;      // Nanosec from arrival to start of transmission.
+
+    FlowOccupancy flows;    // Not merged.
+};
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef QUEUE_T_H
+#define QUEUE_T_H
+
+/*
+ * A queue composed from compile-time policies.
+ *
+ *   Scheduler  holds the packets, picks the next one to send and the one
+ *              to push out when the buffer overflows.
+ *   Admission  decides whether an arriving packet is queued, and whether
+ *              queued packets are pushed out to make room for it.
+ *   Marker     sets ECN on departing packets.
+ *   Logger     reports arrivals, departures and drops.
+ *
+ * Policies are members called without virtual dispatch, so the whole path
+ * from receivePacket to sendOn inlines, and a policy that does nothing
+ * compiles to nothing. Only the Queue entry points stay virtual.
+ *
+ * A scheduler provides empty(), push(pkt), pop(), evict() and complete(pkt),
+ * called when a popped packet has been sent.
+ */
+
+#include "queue.h"
+#include "flowtable.h"
+#include "lossmodel.h"
+
+#include <deque>
+#include <set>
+
+template<class Scheduler, class Admission, class Marker, class Logger>
+class QueueT : public Queue
+{
+public:
+    QueueT(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger)
+        : Queue(bitrate, maxsize, logger), _currentPkt(NULL) {}
+
+    void receivePacket(Packet &pkt)
+    {
+        if (!_admission.admit(*this, pkt)) {
+            drop(pkt);
+            return;
+        }
+
+        _log.arrive(*this, _logger, pkt);
+        _scheduler.push(pkt);
+        _stats.enqueue(pkt, _queuesize);
+        _queuesize += pkt.size();
+        _log.enqueue(*this, _logger, pkt);
+
+        while (_admission.overflow(*this)) {
+            Packet *victim = _scheduler.evict();
+            _queuesize -= victim->size();
+            _stats.evict(*victim);
+            drop(*victim);
+        }
+
+        if (_currentPkt == NULL) {
+            beginService();
+        }
+    }
+
+protected:
+    void beginService()
+    {
+        if (!_scheduler.empty()) {
+            _currentPkt = _scheduler.pop();
+            EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+        }
+    }
+
+    void completeService()
+    {
+        Packet *pkt = _currentPkt;
+        _scheduler.complete(*pkt);
+        _stats.depart(*pkt, drainTime(pkt));
+        _log.depart(*this, _logger, *pkt);
+        _marker.mark(*this, *pkt);
+        pkt->sendOn();
+
+        _queuesize -= pkt->size();
+        _currentPkt = NULL;
+        beginService();
+    }
+
+    inline void drop(Packet &pkt)
+    {
+        _stats.drop(pkt);
+        _log.drop(*this, _logger, pkt);
+        pkt.free();
+    }
+
+    Scheduler _scheduler;
+    Admission _admission;
+    Marker _marker;
+    Logger _log;
+
+    // Current packet being serviced.
+    Packet *_currentPkt;
+};
+
+/*
+ * Schedulers.
+ */
+
+// First in, first out, pushing out the newest packet.
+class FifoScheduler
+{
+public:
+    inline bool empty() const { return _packets.empty(); }
+    inline void push(Packet &pkt) { _packets.push_back(&pkt); }
+    inline void complete(Packet &) {}
+
+    inline Packet* pop()
+    {
+        Packet *pkt = _packets.front();
+        _packets.pop_front();
+        return pkt;
+    }
+
+    inline Packet* evict()
+    {
+        Packet *pkt = _packets.back();
+        _packets.pop_back();
+        return pkt;
+    }
+
+private:
+    std::deque<Packet*> _packets;
+};
+
+class CompareFqPackets
+{
+public:
+    bool operator() (std::pair<uint64_t,Packet*> a,
+                     std::pair<uint64_t,Packet*> b)
+    {
+        if (a.first < b.first) {
+            return true;
+        } else if (a.first > b.first) {
+            return false;
+        } else {
+            return a.second->id() < b.second->id();
+        }
+    }
+};
+
+/*
+ * Emulates byte-by-byte round robin. A packet finishes its flow's round
+ * plus its size, and the round number jumps to the finish round of each
+ * packet sent. The newest packet of the flow furthest ahead is pushed out.
+ */
+class FairScheduler
+{
+public:
+    FairScheduler() : _roundNumber(0) {}
+
+    inline bool empty() const { return _packets.empty(); }
+
+    inline void push(Packet &pkt)
+    {
+        bool newFlow;
+        FlowState &fs = _flows.findOrInsert(pkt.flow().id, newFlow);
+        fs.nPackets++;
+        fs.round = std::max(fs.round, _roundNumber) + pkt.size();
+        _packets.insert(std::make_pair(fs.round, &pkt));
+    }
+
+    inline Packet* pop()
+    {
+        _roundNumber = _packets.begin()->first;
+        Packet *pkt = _packets.begin()->second;
+        _packets.erase(_packets.begin());
+        return pkt;
+    }
+
+    inline Packet* evict()
+    {
+        auto last = std::prev(_packets.end());
+        Packet *pkt = last->second;
+        _packets.erase(last);
+
+        uint32_t flowid = pkt->flow().id;
+        FlowState *fs = _flows.find(flowid);
+        if (fs->nPackets == 1) {
+            _flows.erase(flowid);
+        } else {
+            fs->round -= pkt->size();
+            fs->nPackets--;
+        }
+        return pkt;
+    }
+
+    inline void complete(Packet &pkt)
+    {
+        uint32_t flowid = pkt.flow().id;
+        FlowState *fs = _flows.find(flowid);
+        if (fs->nPackets == 1) {
+            _flows.erase(flowid);
+        } else {
+            fs->nPackets--;
+        }
+    }
+
+private:
+    // Multi-set of all packets, to transmit from head or drop from tail.
+    std::multiset<std::pair<uint64_t,Packet*>, CompareFqPackets> _packets;
+
+    // Per-flow state, present only while the flow has packets.
+    struct FlowState {
+        FlowState() : round(0), nPackets(0) {}
+        uint64_t round;     // Finish round number of the flow.
+        uint32_t nPackets;  // Number of packets enqueued for the flow.
+    };
+    FlowTable<FlowState> _flows;
+
+    uint64_t _roundNumber;  // Current round number.
+};
+
+/*
+ * Admission policies.
+ */
+
+// Drops arriving packets that do not fit.
+class TailDrop
+{
+public:
+    inline bool admit(Queue &q, Packet &pkt) { return q._queuesize + pkt.size() <= q._maxsize; }
+    inline bool overflow(Queue &) { return false; }
+};
+
+// Queues every packet, then pushes out the scheduler's victims until it fits.
+class PushOut
+{
+public:
+    inline bool admit(Queue &, Packet &) { return true; }
+    inline bool overflow(Queue &q) { return q._queuesize > q._maxsize; }
+};
+
+// Drops by a loss model, and at random with rising probability near full.
+class RandomDrop
+{
+public:
+    RandomDrop() : _drop(0) {}
+
+    // Bytes below the buffer size where random drops start.
+    void setDropBand(mem_b drop) { _drop = drop; }
+    void setLossRate(double plr) { _loss.setRate(plr); }
+    void setLossModel(const LossModel &loss) { _loss = loss; }
+
+    inline bool admit(Queue &q, Packet &pkt)
+    {
+        if (_loss.drop()) {
+            return false;
+        }
+
+        mem_b crt = q._queuesize + pkt.size();
+        mem_b threshold = q._maxsize - _drop;
+        double dropProb = (crt > threshold) ? 1100.0 / threshold : 0;
+
+        return !(crt > q._maxsize || drand() < dropProb);
+    }
+
+    inline bool overflow(Queue &) { return false; }
+
+private:
+    mem_b _drop;
+    LossModel _loss;
+};
+
+/*
+ * Markers.
+ */
+
+class NoEcn
+{
+public:
+    inline void mark(Queue &, Packet &) {}
+};
+
+// DCTCP style marking above the queue size threshold for the link speed.
+class DctcpEcn
+{
+public:
+    inline void mark(Queue &q, Packet &pkt)
+    {
+        if (ENABLE_ECN && q._queuesize > q.dctcpThreshold()) {
+            q._stats.mark(pkt);
+        }
+    }
+};
+
+// As DctcpEcn, on the bytes left behind the departing packet, as the base
+// Queue marks.
+class DctcpEcnBehind
+{
+public:
+    inline void mark(Queue &q, Packet &pkt)
+    {
+        if (ENABLE_ECN && q._queuesize - pkt.size() > q.dctcpThreshold()) {
+            q._stats.mark(pkt);
+        }
+    }
+};
+
+/*
+ * Loggers.
+ */
+
+class NullLogging
+{
+public:
+    inline void arrive(Queue &, QueueLogger *, Packet &) {}
+    inline void enqueue(Queue &, QueueLogger *, Packet &) {}
+    inline void depart(Queue &, QueueLogger *, Packet &) {}
+    inline void drop(Queue &, QueueLogger *, Packet &) {}
+};
+
+// Flow traffic events and the queue logger, as every other queue does.
+class QueueLogging
+{
+public:
+    inline void arrive(Queue &q, QueueLogger *, Packet &pkt)
+    {
+        pkt.flow().logTraffic(pkt, q, TrafficLogger::PKT_ARRIVE);
+    }
+
+    inline void enqueue(Queue &q, QueueLogger *logger, Packet &pkt)
+    {
+        if (logger) {
+            logger->logQueue(q, QueueLogger::PKT_ENQUEUE, pkt);
+        }
+    }
+
+    inline void depart(Queue &q, QueueLogger *logger, Packet &pkt)
+    {
+        pkt.flow().logTraffic(pkt, q, TrafficLogger::PKT_DEPART);
+        if (logger) {
+            logger->logQueue(q, QueueLogger::PKT_SERVICE, pkt);
+        }
+    }
+
+    inline void drop(Queue &q, QueueLogger *logger, Packet &pkt)
+    {
+        if (logger) {
+            logger->logQueue(q, QueueLogger::PKT_DROP, pkt);
+        }
+        pkt.flow().logTraffic(pkt, q, TrafficLogger::PKT_DROP);
+    }
+};
+
+// Drop-tail FIFO, the base Queue composed from policies.
+typedef QueueT<FifoScheduler, TailDrop, DctcpEcnBehind, QueueLogging> DropTailQueue;
+
+#endif
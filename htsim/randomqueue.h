@@ -4,19 +4,14 @@
  * A simple FIFO queue that drops randomly when it gets full
  */
 
-#include "queue.h"
+#include "queuet.h"
 
-class RandomQueue : public Queue
+class RandomQueue : public QueueT<FifoScheduler, RandomDrop, DctcpEcnBehind, QueueLogging>
 {
 public:
     RandomQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger, mem_b drop);
-    void receivePacket(Packet &pkt);
     void set_packet_loss_rate(double v);
-
-private:
-    mem_b _drop_th,_drop;
-    int _buffer_drops;
-    double _plr;
+    void setLossModel(const LossModel &loss);
 };
 
 #endif
@@ -5,17 +5,20 @@
 using namespace std;
 
 StocFairQueue::StocFairQueue(linkspeed_bps bitrate, mem_b maxsize,
-        QueueLogger *logger, uint32_t nQueue, uint32_t quantum)
+        QueueLogger *logger, uint32_t nQueue, uint32_t quantum, bool perFlow)
     : Queue(bitrate, maxsize, logger),
-      _nQueue(nQueue), _nPackets(0), _quantum(quantum)
+      _nQueue(nQueue), _nPackets(0), _quantum(quantum), _perFlow(perFlow),
+      _arena(maxsize / MSS_BYTES), _activeHead(PacketArena::NIL), _flowQ(nQueue)
 {
-    // Create the list of FIFO queues.
-    _packets = vector<list<Packet*> >(_nQueue, list<Packet*>());
+    // Create the FIFO queues, in per-flow mode they all start out free.
+    _queues = vector<FifoState>(_nQueue);
 
-    // Initialize state vectors.
-    _credits  = vector<uint32_t>(_nQueue, 0);
-    _Qsize    = vector<uint32_t>(_nQueue, 0);
-    _isActive = vector<bool>(_nQueue, false);
+    if (_perFlow) {
+        _freeQ.reserve(_nQueue);
+        for (uint32_t i = _nQueue; i > 0; i--) {
+            _freeQ.push_back(i - 1);
+        }
+    }
 }
 
 void
@@ -25,17 +28,17 @@ StocFairQueue::beginService()
         // We are guaranteed to have an active queue.
         uint32_t queue;
         while (true) {
-            queue = _activeQ.front();
-            if (_credits[queue] < _packets[queue].back()->size()) {
+            queue = _activeHead;
+            FifoState &q = _queues[queue];
+            if (q.credits < _arena.front(q.packets)->size()) {
                 // Not enough credit, bump to back of queue.
-                _activeQ.pop_front();
-                _activeQ.push_back(queue);
-                _credits[queue] += _quantum;
+                _activeHead = q.next;
+                q.credits += _quantum;
             } else {
                 break;
             }
         }
-        EventList::Get().sourceIsPendingRel(*this, drainTime(_packets[queue].back()));
+        EventList::Get().sourceIsPendingRel(*this, drainTime(_arena.front(_queues[queue].packets)));
     }
 }
 
@@ -44,24 +47,30 @@ StocFairQueue::completeService()
 {
     assert(_nPackets > 0);
 
-    uint32_t queue = _activeQ.front();
-    Packet *pkt = _packets[queue].back();
-    
+    uint32_t queue = _activeHead;
+    FifoState &q = _queues[queue];
+
     // Dequeue and book-keeping.
-    _packets[queue].pop_back();
-    _credits[queue] -= pkt->size();
-    _Qsize[queue] -= pkt->size();
+    Packet *pkt = _arena.pop(q.packets);
+    q.credits -= pkt->size();
+    q.bytes -= pkt->size();
     _queuesize -= pkt->size();
     _nPackets -= 1;
 
     // If queue is empty, remove it from active list.
-    if (_packets[queue].empty()) {
-        _isActive[queue] = false;
-        _activeQ.pop_front();
-        _credits[queue] = 0;
+    if (q.packets.count == 0) {
+        deactivateHead();
+        q.credits = 0;
+
+        // Return the flow's queue to the pool.
+        if (_perFlow) {
+            _flowQ.erase(q.flowid);
+            _freeQ.push_back(queue);
+        }
     }
 
     pkt->flow().logTraffic(*pkt, *this, TrafficLogger::PKT_DEPART);
+    _stats.depart(*pkt, drainTime(pkt));
     if (_logger) {
         _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *pkt);
     }
@@ -92,19 +101,20 @@ StocFairQueue::receivePacket(Packet &pkt)
     pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_ARRIVE);
     bool queueWasEmpty = (_nPackets == 0);
 
-    uint32_t queue = hashFlow(0, pkt.flow().id) % _nQueue;
+    uint32_t queue = flowQueue(pkt.flow().id);
+    FifoState &q = _queues[queue];
 
     // Enqueue it.
-    _packets[queue].push_front(&pkt);
-    _Qsize[queue] += pkt.size();
+    _arena.push(q.packets, &pkt);
+    q.bytes += pkt.size();
+    _stats.enqueue(pkt, _queuesize);
     _queuesize += pkt.size();
     _nPackets += 1;
 
     // If FIFO queue wasn't active, make it active.
-    if (!_isActive[queue]) {
-        _isActive[queue] = true;
-        _activeQ.push_back(queue);
-        _credits[queue] = _quantum;
+    if (!q.active) {
+        activate(queue);
+        q.credits = _quantum;
     }
 
     // If queue was empty, schedule next departure.
@@ -114,14 +124,64 @@ StocFairQueue::receivePacket(Packet &pkt)
     }
 }
 
+uint32_t
+StocFairQueue::flowQueue(uint32_t flowid)
+{
+    if (!_perFlow) {
+        return hashFlow(0, flowid) % _nQueue;
+    }
+
+    bool inserted;
+    uint32_t &queue = _flowQ.findOrInsert(flowid, inserted);
+
+    if (inserted) {
+        // Take a queue from the pool, growing it if all are in use.
+        if (_freeQ.empty()) {
+            _queues.push_back(FifoState());
+            _freeQ.push_back(_queues.size() - 1);
+        }
+        queue = _freeQ.back();
+        _freeQ.pop_back();
+        _queues[queue].flowid = flowid;
+    }
+
+    return queue;
+}
+
 void
-StocFairQueue::dropPacket(Packet &pkt)
+StocFairQueue::activate(uint32_t queue)
 {
-    if (_logger) {
-        _logger->logQueue(*this, QueueLogger::PKT_DROP, pkt);
+    FifoState &q = _queues[queue];
+    q.active = true;
+
+    if (_activeHead == PacketArena::NIL) {
+        q.next = queue;
+        q.prev = queue;
+        _activeHead = queue;
+    } else {
+        // The tail of the ring is just before the head.
+        FifoState &head = _queues[_activeHead];
+        q.next = _activeHead;
+        q.prev = head.prev;
+        _queues[head.prev].next = queue;
+        head.prev = queue;
+    }
+}
+
+void
+StocFairQueue::deactivateHead()
+{
+    uint32_t queue = _activeHead;
+    FifoState &q = _queues[queue];
+    q.active = false;
+
+    if (q.next == queue) {
+        _activeHead = PacketArena::NIL;
+    } else {
+        _queues[q.prev].next = q.next;
+        _queues[q.next].prev = q.prev;
+        _activeHead = q.next;
     }
-    pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_DROP);
-    pkt.free();
 }
 
 uint64_t
@@ -3,27 +3,52 @@
 
 /*
  * An stochastic fair-queue using DRR.
+ *
+ * Flows are either hashed into a fixed set of nQueue FIFOs, or, in per-flow
+ * mode, given their own FIFO from a pool for as long as they have packets
+ * queued (exact DRR).
  */
 
 #include "queue.h"
+#include "flowtable.h"
+#include "packetarena.h"
 
 class StocFairQueue : public Queue
 {
 public:
     StocFairQueue(linkspeed_bps bitrate, mem_b maxsize,
-            QueueLogger *logger, uint32_t nQueue = 32, uint32_t quantum = MSS_BYTES);
+            QueueLogger *logger, uint32_t nQueue = 32, uint32_t quantum = MSS_BYTES,
+            bool perFlow = false);
     void receivePacket(Packet &pkt);
     void printStats();
 
 protected:
     void beginService();
     void completeService();
-    void dropPacket(Packet &pkt);
 
 private:
     uint64_t hashFlow(int index, uint32_t flowid);
 
-    // Number of FIFO queues.
+    // Returns the FIFO queue for a flow, allocating one in per-flow mode.
+    uint32_t flowQueue(uint32_t flowid);
+
+    // Adds a queue at the tail of the active ring / removes the head.
+    void activate(uint32_t queue);
+    void deactivateHead();
+
+    struct FifoState {
+        FifoState() : credits(0), bytes(0), flowid(0), next(PacketArena::NIL),
+                      prev(PacketArena::NIL), active(false) {}
+        PacketArena::Fifo packets;  // Packets in this FIFO.
+        uint32_t credits;           // Credits available.
+        uint32_t bytes;             // Bytes stored.
+        uint32_t flowid;            // Owning flow, in per-flow mode.
+        uint32_t next;              // Active ring links.
+        uint32_t prev;
+        bool active;
+    };
+
+    // Number of FIFO queues (hashed mode) or initial pool size (per-flow mode).
     uint32_t _nQueue;
 
     // Number of packets currently enqueued.
@@ -32,20 +57,21 @@ private:
     // Quantum to transmit in each round.
     uint32_t _quantum;
 
-    // Multiple queues storing all the packets.
-    std::vector<std::list<Packet*> > _packets;
+    // Give every flow its own queue instead of hashing.
+    bool _perFlow;
 
-    // Credits available for each queue.
-    std::vector<uint32_t> _credits;
+    // Shared node pool storing all the packets.
+    PacketArena _arena;
 
-    // Bytes stored in each FIFO queue.
-    std::vector<uint32_t> _Qsize;
+    // State of each FIFO queue.
+    std::vector<FifoState> _queues;
 
-    // Flag for whether a queue is active or not.
-    std::vector<bool> _isActive;
+    // Head of the intrusive ring of active queues, next in line for service.
+    uint32_t _activeHead;
 
-    // List of active queues.
-    std::list<uint32_t> _activeQ;
+    // Per-flow mode: queue of each flow with packets, and unused queues.
+    FlowTable<uint32_t> _flowQ;
+    std::vector<uint32_t> _freeQ;
 };
 
 #endif
@@ -0,0 +1,87 @@
+#include "switch.h"
+#include "prof.h"
+
+using namespace std;
+
+void
+SwitchPort::receivePacket(Packet &pkt)
+{
+    if (_switch.admit(_port, pkt)) {
+        pkt.sendOn();
+    }
+}
+
+Switch::Switch(const string &name, mem_b bufferSize, double alpha, simtime_picosec period)
+    : EventSource(name), _bufferSize(bufferSize), _alpha(alpha), _period(period), _peak(0)
+{
+    if (_period > 0) {
+        EventList::Get().sourceIsPendingRel(*this, _period);
+    }
+}
+
+PacketSink*
+Switch::addPort(Queue *queue)
+{
+    _ports.push_back(queue);
+    _sinks.push_back(new SwitchPort(*this, _ports.size() - 1));
+    _drops.push_back(0);
+    return _sinks.back();
+}
+
+mem_b
+Switch::occupancy() const
+{
+    mem_b total = 0;
+    for (auto q : _ports) {
+        total += q->_queuesize;
+    }
+    return total;
+}
+
+bool
+Switch::admit(uint32_t port, Packet &pkt)
+{
+    mem_b total = occupancy();
+    mem_b free = (total < _bufferSize) ? _bufferSize - total : 0;
+    mem_b queued = _ports[port]->_queuesize;
+
+    if (pkt.size() > free || queued + pkt.size() > _alpha * free) {
+        _drops[port]++;
+        _ports[port]->_stats.drop(pkt);
+        pkt.flow().logTraffic(pkt, *_ports[port], TrafficLogger::PKT_DROP);
+        pkt.free();
+        return false;
+    }
+
+    _peak = max(_peak, total + pkt.size());
+    return true;
+}
+
+void
+Switch::doNextEvent()
+{
+    printStats();
+    _peak = occupancy();
+    EventList::Get().sourceIsPendingRel(*this, _period);
+}
+
+void
+Switch::printStats()
+{
+    uint64_t drops = 0;
+    for (auto d : _drops) {
+        drops += d;
+    }
+
+#if MING_PROF
+    cout << str() << " " << timeAsUs(EventList::Get().now());
+#else
+    cout << str() << " " << timeAsMs(EventList::Get().now());
+#endif
+    cout << " switch total " << occupancy()
+         << " peak " << _peak << " drops " << drops << " ports";
+    for (auto q : _ports) {
+        cout << " " << q->_queuesize;
+    }
+    cout << endl;
+}
@@ -0,0 +1,64 @@
+#ifndef SWITCH_H
+#define SWITCH_H
+
+/*
+ * A switch whose egress queues share one packet buffer.
+ *
+ * Packets are admitted to an egress queue with Choudhury-Hahne dynamic
+ * thresholds: a port may hold at most alpha times the buffer still free,
+ * so the limit of every port tightens as the buffer fills and a congested
+ * port cannot take all of it. Admission sits in the route just ahead of
+ * the egress queue, so any Queue type can be used for the ports.
+ */
+
+#include "queue.h"
+
+#include <string>
+#include <vector>
+
+class Switch;
+
+// Entry point of a switch egress port, placed in routes before its queue.
+class SwitchPort : public PacketSink
+{
+public:
+    SwitchPort(Switch &sw, uint32_t port) : _switch(sw), _port(port) {}
+    void receivePacket(Packet &pkt);
+
+private:
+    Switch &_switch;
+    uint32_t _port;
+};
+
+class Switch : public EventSource
+{
+public:
+    // Occupancy is reported every period, 0 disables reporting.
+    Switch(const std::string &name, mem_b bufferSize, double alpha,
+            simtime_picosec period = 0);
+
+    // Adds an egress queue, returns the sink packets must enter it through.
+    PacketSink* addPort(Queue *queue);
+
+    // Admits a packet to a port, or drops it.
+    bool admit(uint32_t port, Packet &pkt);
+
+    // Bytes held by all ports.
+    mem_b occupancy() const;
+
+    void doNextEvent();
+    void printStats();
+
+private:
+    mem_b _bufferSize;                  // Shared buffer size.
+    double _alpha;                      // Dynamic threshold coefficient.
+    simtime_picosec _period;
+
+    std::vector<Queue*> _ports;
+    std::vector<SwitchPort*> _sinks;
+    std::vector<uint64_t> _drops;       // Admission drops per port.
+
+    mem_b _peak;                        // Peak occupancy since the last report.
+};
+
+#endif
@@ -10,10 +10,22 @@
 using namespace std;
 
 bool TcpSrc::_enable_dctcp = false;
+bool TcpSrc::_enable_pfabric = false;
+bool TcpSrc::_enable_sack = false;
 map<uint64_t, uint64_t> TcpSrc::slacks;
 map<uint64_t, uint64_t> TcpSink::slacks;
 uint64_t TcpSrc::totalPkts = 0;
 uint64_t TcpSink::totalPkts = 0;
+uint32_t TcpSink::_ack_every = 1;
+simtime_picosec TcpSink::_ack_delay = timeFromUs(40);
+
+void
+TcpSink::setDelayedAck(uint32_t every,
+                       simtime_picosec delay)
+{
+    _ack_every = max(every, 1u);
+    _ack_delay = delay;
+}
 
 TcpSrc::TcpSrc(TcpLogger *logger,
                TrafficLogger *pktlogger,
@@ -26,14 +38,15 @@ TcpSrc::TcpSrc(TcpLogger *logger,
                _recover_seq(0),
                _dupacks(0),
                _drops(0),
+               _tso_bytes(MSS_BYTES),
                _rtt(0),
                _rto(timeFromUs(INIT_RTO_US)),
                _mdev(0),
-               _RFC2988_RTO_timeout(0),
                _alpha(0.0),
                _marked_pkts(0),
                _total_pkts(0),
                _dctcp_cwnd(0),
+               _high_rxt(0),
                _logger(logger)
 {
     // Constructor
@@ -63,70 +76,77 @@ TcpSrc::printStatus()
 }
 
 void
-TcpSrc::doNextEvent()
+TcpSrc::onTimer(Timer timer)
 {
     simtime_picosec current_ts = EventList::Get().now();
 
-    // This is a new flow, start sending packets.
-    if (_state == IDLE) {
-        _state = SLOW_START;
-        _cwnd = 2 * MSS_BYTES;
-        _dctcp_cwnd = _cwnd;
-        sendPackets();
-    }
-
-    // Cleanup the finished flow.
-    else if (_state == FINISH) {
-        // If no more flow packets in the system, delete all objects.
-        // Make sure no one else has access to these.
-        if (_flow._nPackets == 0) {
-            delete _sink;
-            delete _route_fwd;
-            delete _route_rev;
-            delete this;
-            return;
-        }
-    }
+    switch (timer) {
+        // This is a new flow, start sending packets.
+        case START:
+            _state = SLOW_START;
+            _cwnd = 2 * MSS_BYTES;
+            _dctcp_cwnd = _cwnd;
+            sendPackets();
+            break;
 
-    // Retransmission timeout.
-    else if (_RFC2988_RTO_timeout != 0 && current_ts >= _RFC2988_RTO_timeout) {
+        // Cleanup the finished flow.
+        case TEARDOWN:
+            // If no more flow packets in the system, delete all objects.
+            // Make sure no one else has access to these.
+            if (_flow._nPackets == 0) {
+                delete _sink;
+                delete _route_fwd;
+                delete _route_rev;
+                delete this;
+                return;
+            }
+            setTimer(TEARDOWN, current_ts + (_rtt != 0 ? _rtt : timeFromUs(MIN_RTO_US)));
+            break;
 
-        cout << str() << " at " << timeAsMs(current_ts)
-             << " RTO " << timeAsUs(_rto)
-             << " MDEV " << timeAsUs(_mdev)
-             << " RTT "<< timeAsUs(_rtt)
-             << " SEQ " << _last_acked / MSS_BYTES
-             << " CWND "<< _cwnd / MSS_BYTES
-             << " RTO_timeout " << timeAsMs(_RFC2988_RTO_timeout)
-             << " STATE " << _state << endl;
+        // Retransmission timeout.
+        case RTO:
+            cout << str() << " at " << timeAsMs(current_ts)
+                 << " RTO " << timeAsUs(_rto)
+                 << " MDEV " << timeAsUs(_mdev)
+                 << " RTT "<< timeAsUs(_rtt)
+                 << " SEQ " << _last_acked / MSS_BYTES
+                 << " CWND "<< _cwnd / MSS_BYTES
+                 << " RTO_timeout " << timeAsMs(current_ts)
+                 << " STATE " << _state << endl;
+
+            if (_logger) _logger->logTcp(*this, TcpLogger::TCP_TIMEOUT);
+
+            if (_state == FAST_RECOV) {
+                uint32_t flightsize = _highest_sent - _last_acked;
+                _cwnd = min(_ssthresh, flightsize + MSS_BYTES);
+            }
 
-        if (_logger) _logger->logTcp(*this, TcpLogger::TCP_TIMEOUT);
+            _ssthresh = max(_cwnd / 2, (uint32_t)(MSS_BYTES * 2));
 
-        if (_state == FAST_RECOV) {
-            uint32_t flightsize = _highest_sent - _last_acked;
-            _cwnd = min(_ssthresh, flightsize + MSS_BYTES);
-        }
+            _cwnd = MSS_BYTES;
+            _state = SLOW_START;
+            _recover_seq = _highest_sent;
+            _highest_sent = _last_acked + MSS_BYTES;
+            _dupacks = 0;
 
-        _ssthresh = max(_cwnd / 2, (uint32_t)(MSS_BYTES * 2));
+            // The sink may have reneged, start the scoreboard over (RFC 2018).
+            _sacked.clear();
+            _high_rxt = _last_acked;
 
-        _cwnd = MSS_BYTES;
-        _state = SLOW_START;
-        _recover_seq = _highest_sent;
-        _highest_sent = _last_acked + MSS_BYTES;
-        _dupacks = 0;
+            // Reset rtx timerRFC 2988 5.5 & 5.6
+            _rto *= 2;
+            setTimer(RTO, current_ts + _rto);
 
-        // Reset rtx timerRFC 2988 5.5 & 5.6
-        _rto *= 2;
-        _RFC2988_RTO_timeout = current_ts + _rto;
+            // Move off a failed link before retransmitting.
+            if (_flowgen != NULL) {
+                _flowgen->repath(*this);
+            }
 
-        retransmitPacket(1);
-    }
+            retransmitPacket(1, _last_acked);
+            break;
 
-    // Schedule periodic RTT checks.
-    if (_rtt != 0) {
-        EventList::Get().sourceIsPendingRel(*this, _rtt);
-    } else {
-        EventList::Get().sourceIsPendingRel(*this, timeFromUs(MIN_RTO_US));
+        default:
+            break;
     }
 }
 
@@ -138,6 +158,13 @@ TcpSrc::receivePacket(Packet &pkt)
     DataAck::seq_t seqno = p->ackno();
     simtime_picosec ts = p->ts();
 
+    // Blocks name first bytes, the scoreboard counts from zero.
+    for (uint32_t i = 0; _enable_sack && i < p->nSack(); i++) {
+        if (p->sack(i).end - 1 > max(seqno, _last_acked)) {
+            _sacked.insert(p->sack(i).start - 1, p->sack(i).end - 1);
+        }
+    }
+
     pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_RCVDESTROY);
     p->free();
 
@@ -152,6 +179,8 @@ TcpSrc::receivePacket(Packet &pkt)
             _flowgen->finishFlow(id);
         }
         _state = FINISH;
+        cancelTimer(RTO);
+        setTimer(TEARDOWN, current_ts);
 
         // Ming added _flowsize
         cout << setprecision(6) << "Flow " << str() << " " << id << " size " << _flowsize
@@ -201,9 +230,14 @@ TcpSrc::receivePacket(Packet &pkt)
     }
 
     if (_enable_dctcp) {
-        // Update ECN counters.
+        // Update ECN counters, by the segments a cumulative ack covers.
+        uint32_t acked_pkts = 1;
+        if (seqno > _last_acked) {
+            acked_pkts = (seqno - _last_acked + MSS_BYTES - 1) / MSS_BYTES;
+        }
+
         if (pkt.getFlag(Packet::ECN_REV)) {
-            _marked_pkts += 1;
+            _marked_pkts += acked_pkts;
 
             // If in slow_start, exit and update _sshthresh.
             if (_state == SLOW_START && _ssthresh > _cwnd) {
@@ -211,7 +245,7 @@ TcpSrc::receivePacket(Packet &pkt)
                 _ssthresh = _cwnd;
             }
         }
-        _total_pkts += 1;
+        _total_pkts += acked_pkts;
 
         // Update _alpha and _cwnd, roughly once per cwnd of data.
         if (_total_pkts * MSS_BYTES > _dctcp_cwnd) {
@@ -236,22 +270,27 @@ TcpSrc::receivePacket(Packet &pkt)
         }
     }
 
+    if (_enable_sack) {
+        receiveSackAck(seqno);
+        return;
+    }
+
     // Brand new ack.
     if (seqno > _last_acked) {
 
-        // RFC 2988 5.3
-        _RFC2988_RTO_timeout = current_ts + _rto;
-
-        // RFC 2988 5.2
+        // RFC 2988 5.2 & 5.3
         if (seqno == _highest_sent) {
-            _RFC2988_RTO_timeout = 0;
+            cancelTimer(RTO);
+        } else {
+            setTimer(RTO, current_ts + _rto);
         }
 
         // Best behaviour: proper ack of a new packet, when we were expecting it.
         if (_state != FAST_RECOV) { // _state == SLOW_START || CONG_AVOID
+            uint64_t acked = seqno - _last_acked;
             _last_acked = seqno;
             _dupacks = 0;
-            inflateWindow();
+            inflateWindow(acked);
 
             if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV);
             sendPackets();
@@ -288,7 +327,7 @@ TcpSrc::receivePacket(Packet &pkt)
         _cwnd += MSS_BYTES;
 
         if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_FR);
-        retransmitPacket(2);
+        retransmitPacket(2, _last_acked);
         sendPackets();
         return;
     }
@@ -329,22 +368,24 @@ TcpSrc::receivePacket(Packet &pkt)
     // _recover_seq is the value of the ack that tells us things are back to normal
     _recover_seq = _highest_sent;
 
-    retransmitPacket(3);
+    retransmitPacket(3, _last_acked);
     if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_DUP_FASTXMIT);
 }
 
 void
-TcpSrc::inflateWindow()
+TcpSrc::inflateWindow(uint64_t acked)
 {
     // Be very conservative - possibly not the best we can do, but
-    // the alternative has bad side effects.
+    // the alternative has bad side effects. An ack counts for the bytes
+    // it covers, up to ABC_LIMIT (RFC 3465 byte counting).
     int newly_acked = (_last_acked + _cwnd) - _highest_sent;
+    int limit = min<uint64_t>(acked, ABC_LIMIT);
     int increment;
 
     if (newly_acked < 0) {
         return;
-    } else if (newly_acked > MSS_BYTES) {
-        newly_acked = MSS_BYTES;
+    } else if (newly_acked > limit) {
+        newly_acked = limit;
     }
 
     if (_cwnd < _ssthresh) {
@@ -375,70 +416,89 @@ TcpSrc::sendPackets()
     }
 
     while (_last_acked + _cwnd >= _highest_sent + MSS_BYTES) {
-        DataPacket *p = DataPacket::newpkt(_flow, *_route_fwd, _highest_sent + 1, MSS_BYTES);
-
-        p->flow().logTraffic(*p, *this, TrafficLogger::PKT_CREATESEND);
-        p->set_ts(current_ts);
-
-        // pFabric priority.
-        //if (ENABLE_PFABRIC) {
-        //    p->setPriority(_flowsize);
-        //}
-
-        if (_enable_deadline) {
-            // Calculate and set deadline for this packet.
-            simtime_picosec timeRemaining;
-            //if (_deadline - timeFromUs(8) > current_ts) {
-            if (_deadline > current_ts) {
-                timeRemaining = _deadline - current_ts;
-            } else {
-                timeRemaining = 0;
+        // With segment offload, all the whole segments the window allows.
+        uint64_t size = MSS_BYTES;
+        if (_tso_bytes > MSS_BYTES) {
+            size = min<uint64_t>(_last_acked + _cwnd - _highest_sent, _tso_bytes);
+            if (_flowsize > 0) {
+                size = min(size, _flowsize - _highest_sent + MSS_BYTES - 1);
             }
+            size -= size % MSS_BYTES;
+        }
+        sendPacket(size);
 
-            uint64_t packetsRemaining = (_flowsize - _highest_sent) / MSS_BYTES + 1;
-            uint64_t slack = (timeRemaining / packetsRemaining);
-            uint64_t hist = slack/1000000;
+        if (_flowsize > 0 && _highest_sent >= _flowsize) {
+            break;
+        }
+    }
+}
 
-            if (slacks.find(hist) == slacks.end()) {
-                slacks[hist] = 1;
-            } else {
-                slacks[hist] += 1;
-            }
-            totalPkts += 1;
+// Sends the next size bytes of new data as one packet.
+void
+TcpSrc::sendPacket(uint32_t size)
+{
+    simtime_picosec current_ts = EventList::Get().now();
+    DataPacket *p = DataPacket::newpkt(_flow, *_route_fwd, _highest_sent + 1, size);
 
-            p->setFlag(Packet::DEADLINE);
-            p->setPriority(llround(timeAsNs(slack)));
-        }
+    p->flow().logTraffic(*p, *this, TrafficLogger::PKT_CREATESEND);
+    p->set_ts(current_ts);
 
-        _highest_sent += MSS_BYTES;
-        _packets_sent += MSS_BYTES;
-        p->sendOn();
+    // pFabric priority.
+    if (_enable_pfabric) {
+        p->setPriority(remainingPriority(_highest_sent));
+    }
 
-        if (_RFC2988_RTO_timeout == 0) { // RFC2988 5.1
-            _RFC2988_RTO_timeout = current_ts + _rto;
+    if (_enable_deadline) {
+        // Calculate and set deadline for this packet.
+        simtime_picosec timeRemaining;
+        //if (_deadline - timeFromUs(8) > current_ts) {
+        if (_deadline > current_ts) {
+            timeRemaining = _deadline - current_ts;
+        } else {
+            timeRemaining = 0;
         }
 
-        if (_flowsize > 0 && _highest_sent >= _flowsize) {
-            break;
+        uint64_t packetsRemaining = (_flowsize - _highest_sent) / MSS_BYTES + 1;
+        uint64_t slack = (timeRemaining / packetsRemaining);
+        uint64_t hist = slack/1000000;
+
+        if (slacks.find(hist) == slacks.end()) {
+            slacks[hist] = 1;
+        } else {
+            slacks[hist] += 1;
         }
+        totalPkts += 1;
+
+        p->setFlag(Packet::DEADLINE);
+        p->setPriority(llround(timeAsNs(slack)));
+    }
+
+    _highest_sent += size;
+    _packets_sent += size;
+    p->sendOn();
+
+    if (!timerSet(RTO)) { // RFC2988 5.1
+        setTimer(RTO, current_ts + _rto);
     }
 }
 
+// Resends the segment following byte offset.
 void
-TcpSrc::retransmitPacket(int reason)
+TcpSrc::retransmitPacket(int reason,
+                         uint64_t offset)
 {
     if (TRACE_FLOW == str()) {
         cout << str() << " RETX " << EventList::Get().now() << " " << reason << endl;
     }
 
-    DataPacket *p = DataPacket::newpkt(_flow, *_route_fwd, _last_acked + 1, MSS_BYTES);
+    DataPacket *p = DataPacket::newpkt(_flow, *_route_fwd, offset + 1, MSS_BYTES);
     p->flow().logTraffic(*p, *this, TrafficLogger::PKT_CREATESEND);
     p->set_ts(EventList::Get().now());
 
     // pFabric priority.
-    //if (ENABLE_PFABRIC) {
-    //    p->setPriority(_flowsize);
-    //}
+    if (_enable_pfabric) {
+        p->setPriority(remainingPriority(offset));
+    }
 
     if (_enable_deadline) {
         p->setFlag(Packet::DEADLINE);
@@ -448,19 +508,212 @@ TcpSrc::retransmitPacket(int reason)
     _packets_sent += MSS_BYTES;
     p->sendOn();
 
-    if(_RFC2988_RTO_timeout == 0) { // RFC2988 5.1
-        _RFC2988_RTO_timeout = EventList::Get().now() + _rto;
+    if (!timerSet(RTO)) { // RFC2988 5.1
+        setTimer(RTO, EventList::Get().now() + _rto);
+    }
+}
+
+// Ack processing with a SACK scoreboard, RFC 6675. Outside recovery it
+// behaves as NewReno; in recovery cwnd is fixed at ssthresh and every ack
+// sends what the pipe estimate leaves room for, lost holes first.
+void
+TcpSrc::receiveSackAck(DataAck::seq_t seqno)
+{
+    simtime_picosec current_ts = EventList::Get().now();
+
+    // Brand new ack.
+    if (seqno > _last_acked) {
+
+        // RFC 2988 5.2 & 5.3
+        if (seqno == _highest_sent) {
+            cancelTimer(RTO);
+        } else {
+            setTimer(RTO, current_ts + _rto);
+        }
+
+        uint64_t acked = seqno - _last_acked;
+        _last_acked = seqno;
+        _sacked.eraseBelow(_last_acked);
+        _dupacks = 0;
+
+        if (_state != FAST_RECOV) {
+            inflateWindow(acked);
+
+            if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV);
+            sendPackets();
+            return;
+        }
+
+        if (seqno >= _recover_seq) {
+            uint32_t flightsize = _highest_sent - seqno;
+            _cwnd = min(_ssthresh, flightsize + MSS_BYTES);
+            _state = CONG_AVOID;
+
+            if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_FR_END);
+            sendPackets();
+            return;
+        }
+
+        // Partial ack, keep repairing.
+        if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_FR);
+        sendRecovery();
+        return;
+    }
+
+    // It's a dup ack.
+    if (_state == FAST_RECOV) {
+        if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_DUP_FR);
+        sendRecovery();
+        return;
+    }
+
+    // Enough dupacks, or enough SACKed above the first hole to call it lost.
+    _dupacks++;
+
+    if (_dupacks < 3 && lostBelow() <= _last_acked) {
+        if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_DUP);
+        sendPackets();
+        return;
+    }
+
+    if (_last_acked < _recover_seq) {
+        // See RFC 3782: if we haven't recovered from timeouts etc. don't do fast recovery.
+        if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_3DUPNOFR);
+        return;
     }
+
+    _drops++;
+
+    _ssthresh = max(_cwnd / 2, (uint32_t)(MSS_BYTES * 2));
+    _cwnd = _ssthresh;
+    _state = FAST_RECOV;
+    _recover_seq = _highest_sent;
+
+    // The first hole goes now, and the timer restarts with it so a repair
+    // queued behind the window is not mistaken for its loss.
+    retransmitPacket(3, _last_acked);
+    _high_rxt = _last_acked + MSS_BYTES;
+    setTimer(RTO, current_ts + _rto);
+    if (_logger) _logger->logTcp(*this, TcpLogger::TCP_RCV_DUP_FASTXMIT);
+
+    sendRecovery();
 }
 
+// Sends while cwnd exceeds the pipe: holes judged lost, then new data,
+// then holes below the highest SACK (RFC 6675 NextSeg rules 1 to 3).
+void
+TcpSrc::sendRecovery()
+{
+    uint64_t lost = lostBelow();
+    uint64_t high_sacked = _sacked.empty() ? 0 : _sacked.rbegin()->second;
+
+    // SetPipe: unSACKed bytes not yet lost, plus those retransmitted.
+    uint64_t pipe = unsacked(_last_acked, _highest_sent)
+                  - unsacked(_last_acked, min(lost, _highest_sent))
+                  + unsacked(_last_acked, min(_high_rxt, _highest_sent));
+
+    while (_cwnd >= pipe + MSS_BYTES) {
+        uint64_t hole = max(_high_rxt, _last_acked);
+        auto held = _sacked.find(hole);
+        if (held != _sacked.end()) {
+            hole = held->second;
+        }
 
-TcpSink::TcpSink() : DataSink() {}
+        bool fresh = (_flowsize == 0 || _highest_sent < _flowsize);
+        if (hole < lost || (!fresh && hole < high_sacked)) {
+            retransmitPacket(2, hole);
+            _high_rxt = hole + MSS_BYTES;
+        } else if (fresh) {
+            sendPacket(MSS_BYTES);
+        } else {
+            break;
+        }
+        pipe += MSS_BYTES;
+    }
+}
+
+// Offset below which every unSACKed byte counts as lost: DupThresh ranges
+// or more than (DupThresh - 1) * MSS bytes are SACKed above it.
+uint64_t
+TcpSrc::lostBelow() const
+{
+    uint32_t ranges = 0;
+    uint64_t bytes = 0;
+
+    for (auto it = _sacked.rbegin(); it != _sacked.rend(); it++) {
+        ranges++;
+        bytes += it->second - it->first;
+        if (ranges >= 3 || bytes > 2 * MSS_BYTES) {
+            return it->first;
+        }
+    }
+    return _last_acked;
+}
+
+// Bytes in [from, to) not on the scoreboard.
+uint64_t
+TcpSrc::unsacked(uint64_t from,
+                 uint64_t to) const
+{
+    if (to <= from) {
+        return 0;
+    }
+
+    uint64_t bytes = to - from;
+    for (auto it = _sacked.begin(); it != _sacked.end() && it->first < to; it++) {
+        if (it->second > from) {
+            bytes -= min(it->second, to) - max(it->first, from);
+        }
+    }
+    return bytes;
+}
+
+uint32_t
+TcpSrc::remainingPriority(uint64_t seqno)
+{
+    // Bytes left to send from seqno, flows of unknown size go last.
+    if (_flowsize == 0) {
+        return UINT32_MAX;
+    }
+    uint64_t remaining = (_flowsize > seqno) ? _flowsize - seqno : 0;
+    return (uint32_t)min<uint64_t>(remaining, UINT32_MAX);
+}
+
+TcpSink::TcpSink() : DataSink(), _held(0), _held_ts(0), _held_ce(false), _ack_timer(NULL) {}
+
+TcpSink::~TcpSink()
+{
+    if (_ack_timer != NULL) {
+        if (_ack_timer->_pending != EventList::Get().noEvent()) {
+            EventList::Get().cancelPendingSource(_ack_timer->_pending);
+        }
+        delete _ack_timer;
+    }
+}
+
+TcpSink::AckTimer::AckTimer(TcpSink &sink)
+                           : EventSource("acktimer"),
+                             _sink(sink),
+                             _pending(EventList::Get().noEvent()) {}
+
+void
+TcpSink::AckTimer::doNextEvent()
+{
+    _pending = EventList::Get().noEvent();
+    _sink.sendAck(_sink._cumulative_ack);
+}
 
 void
 TcpSink::receivePacket(Packet &pkt)
 {
     DataPacket *p = (DataPacket*)(&pkt);
     simtime_picosec ts = p->ts();
+    bool ce = p->getFlag(Packet::ECN_FWD);
+
+    // Next expected with no hole behind it, anything else is acked at once
+    // so the source sees its dupacks (RFC 5681 4.2).
+    DataAck::seq_t prev_ack = _cumulative_ack;
+    bool in_order = (p->seqno() == prev_ack + 1 && _received.empty());
     processDataPacket(*p);
 
     if (p->getFlag(Packet::DEADLINE)) {
@@ -477,12 +730,53 @@ TcpSink::receivePacket(Packet &pkt)
     pkt.flow().logTraffic(pkt, *this, TrafficLogger::PKT_RCVDESTROY);
     p->free();
 
-    DataAck *ack = DataAck::newpkt(_src->_flow, *_route, 1, _cumulative_ack);
+    // DCTCP: when CE flips, ack what is held under the old state first so
+    // the source counts marks exactly (RFC 8257 3.2).
+    if (_held > 0 && ce != _held_ce) {
+        sendAck(prev_ack);
+    }
+
+    if (_held == 0) {
+        _held_ts = ts;
+        _held_ce = ce;
+    }
+    _held++;
+
+    // The last byte stands in for a FIN, which is acked at once.
+    bool last = (_src->_flowsize > 0 && _cumulative_ack >= _src->_flowsize);
+
+    if (_held >= _ack_every || !in_order || last) {
+        sendAck(_cumulative_ack);
+    } else {
+        if (_ack_timer == NULL) {
+            _ack_timer = new AckTimer(*this);
+        }
+        if (_ack_timer->_pending == EventList::Get().noEvent()) {
+            EventList &ev = EventList::Get();
+            _ack_timer->_pending = ev.sourceIsPending(*_ack_timer, ev.now() + _ack_delay);
+        }
+    }
+}
+
+void
+TcpSink::sendAck(DataAck::seq_t ackno)
+{
+    DataAck *ack = DataAck::newpkt(_src->_flow, *_route, 1, ackno);
     ack->flow().logTraffic(*ack, *this, TrafficLogger::PKT_CREATESEND);
-    ack->set_ts(ts);
-    if (p->getFlag(Packet::ECN_FWD)) {
+    ack->set_ts(_held_ts);
+    if (_held_ce) {
         ack->setFlag(Packet::ECN_REV);
     }
+    if (TcpSrc::_enable_sack) {
+        SackBlock blocks[DataAck::MAX_SACK];
+        ack->setSack(blocks, sackBlocks(blocks, DataAck::MAX_SACK));
+    }
+
+    _held = 0;
+    if (_ack_timer != NULL && _ack_timer->_pending != EventList::Get().noEvent()) {
+        EventList::Get().cancelPendingSource(_ack_timer->_pending);
+        _ack_timer->_pending = EventList::Get().noEvent();
+    }
     ack->sendOn();
 }
 
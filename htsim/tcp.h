@@ -9,6 +9,9 @@
 
 #define DCTCP_GAIN 0.0625
 
+// Most an ack may grow cwnd by, RFC 3465 byte counting with L = 2.
+#define ABC_LIMIT (2 * MSS_BYTES)
+
 class TcpSink;
 class FlowGenerator;
 
@@ -20,7 +23,6 @@ class TcpSrc : public DataSource
             uint32_t flowsize = 0, simtime_picosec duration = 0);
 
     void printStatus();
-    void doNextEvent();
     void receivePacket(Packet &pkt);
 
     // Flow status.
@@ -40,9 +42,12 @@ class TcpSrc : public DataSource
     uint16_t _dupacks;
     uint32_t _drops;
 
+    // Largest segment handed to the endhost queue, above MSS only when
+    // that queue segments it (TsoQueue).
+    uint32_t _tso_bytes;
+
     // RTT, RTO estimates.
     simtime_picosec _rtt, _rto, _mdev;
-    simtime_picosec _RFC2988_RTO_timeout;
 
     // DCTCP variables;
     double _alpha;
@@ -53,14 +58,37 @@ class TcpSrc : public DataSource
     // DCTCP enable flag.
     static bool _enable_dctcp;
 
+    // pFabric enable flag, stamps the remaining flow size as priority.
+    static bool _enable_pfabric;
+
+    // SACK enable flag, sinks report held ranges and losses are repaired
+    // from the scoreboard (RFC 6675) instead of one hole per RTT.
+    static bool _enable_sack;
+
     static std::map<uint64_t, uint64_t> slacks;
     static uint64_t totalPkts;
 
+    protected:
+    void onTimer(Timer timer);
+
     private:
     // Mechanism
-    void inflateWindow();
+    void inflateWindow(uint64_t acked);
     void sendPackets();
-    void retransmitPacket(int reason);
+    void sendPacket(uint32_t size);
+    void retransmitPacket(int reason, uint64_t offset);
+    uint32_t remainingPriority(uint64_t seqno);
+
+    // SACK recovery.
+    void receiveSackAck(DataAck::seq_t seqno);
+    void sendRecovery();
+    uint64_t lostBelow() const;
+    uint64_t unsacked(uint64_t from, uint64_t to) const;
+
+    // Scoreboard of bytes the sink holds above _last_acked, counted from
+    // zero like _last_acked, and the end of the last retransmitted hole.
+    IntervalSet _sacked;
+    uint64_t _high_rxt;
 
     // Housekeeping
     TcpLogger *_logger;
@@ -71,11 +99,42 @@ class TcpSink : public DataSink
     friend class TcpSrc;
     public:
     TcpSink();
+    ~TcpSink();
     void receivePacket(Packet &pkt);
     void printStatus();
 
+    // Acks every _ack_every in order segments, or _ack_delay after the
+    // first one held. Out of order data is acked at once.
+    static uint32_t _ack_every;
+    static simtime_picosec _ack_delay;
+
+    // Sets the above, acking at least every segment.
+    static void setDelayedAck(uint32_t every, simtime_picosec delay);
+
     static std::map<uint64_t, uint64_t> slacks;
     static uint64_t totalPkts;
+
+    private:
+    void sendAck(DataAck::seq_t ackno);
+
+    // Segments received since the last ack, the timestamp of the first
+    // to echo, and their ECN state.
+    uint32_t _held;
+    simtime_picosec _held_ts;
+    bool _held_ce;
+
+    // Sends the held ack when the delay runs out. Made on the first ack
+    // held, so sinks acking every segment add no event sources.
+    class AckTimer : public EventSource
+    {
+        public:
+        AckTimer(TcpSink &sink);
+        void doNextEvent();
+
+        TcpSink &_sink;
+        EventList::Handle _pending;   // Or noEvent().
+    };
+    AckTimer *_ack_timer;
 };
 
 #endif /* TCP_H_ */
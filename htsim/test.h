@@ -16,6 +16,7 @@ typedef std::unordered_map<std::string,std::string> ArgList;
 void single_link_simulation(const ArgList &, Logfile &);
 void conga_testbed(const ArgList &, Logfile &);
 void fat_tree_testbed(const ArgList &, Logfile &);
+void queue_benchmark(const ArgList &, Logfile &);
 
 inline int 
 run_experiment(uint32_t expt,
@@ -38,6 +39,11 @@ run_experiment(uint32_t expt,
             fat_tree_testbed(args, logfile);
             break;
 
+        case 4:
+            // Measures the cost per packet of queue disciplines.
+            queue_benchmark(args, logfile);
+            break;
+
         default:
             return -1;
     }
@@ -50,6 +56,7 @@ print_experiment_list()
     std::cerr << "  1" << " single_link_simulation" << std::endl;
     std::cerr << "  2" << " conga_testbed" << std::endl;
     std::cerr << "  3" << " fat_tree_testbed" << std::endl;
+    std::cerr << "  4" << " queue_benchmark" << std::endl;
 }
 
 /* Helper functions for parsing arguments. */
@@ -2,8 +2,10 @@
 #include "logfile.h"
 #include "loggers.h"
 #include "aprx-fairqueue.h"
+#include "aqmqueue.h"
 #include "fairqueue.h"
 #include "priorityqueue.h"
+#include "queuet.h"
 #include "stoc-fairqueue.h"
 #include "flow-generator.h"
 #include "pipe.h"
@@ -36,7 +38,10 @@ namespace conga {
     std::vector<Queue*> leaf_switches;
     std::vector<std::vector<Queue*>> servers;
 
+    AQMcfg aqmcfg; // RED/CoDel/PIE config.
+
     void generateRoute(route_t*& fwd, route_t*& rev, uint32_t& src_id, uint32_t& dst_id);
+    void createQueue(std::string &qType, Queue *&queue, uint64_t speed, uint64_t buffer, QueueLogger *qs);
 }
 
 using namespace std;
@@ -48,11 +53,28 @@ conga_testbed(const ArgList &args, Logfile &logfile)
     double duration = 10.0;
     double utilization = 0.75;
     uint32_t AvgFlowSize = 100000;    // Average flow size.
+    string QueueType = "fq";          // Switch queue type (fq/droptail/red/codel/pie)
     
     // Parse arguments with defaults
     parseDouble(args, "duration", duration);
     parseDouble(args, "utilization", utilization);
     parseInt(args, "flowsize", AvgFlowSize);
+    parseString(args, "queue", QueueType);
+
+    uint32_t Sack = 0;
+    parseInt(args, "sack", Sack);
+    TcpSrc::_enable_sack = (Sack != 0);
+
+    uint32_t DelAck = TcpSink::_ack_every;
+    double DelAckTimeout = timeAsUs(TcpSink::_ack_delay);
+    parseInt(args, "delack", DelAck);
+    parseDouble(args, "delackTimeout", DelAckTimeout);
+    TcpSink::setDelayedAck(DelAck, timeFromUs(DelAckTimeout));
+
+    uint32_t Tso = 0;
+    parseInt(args, "tso", Tso);
+
+    parseAqmArgs(args, aqmcfg);
 
     // Create TCP logger
     TcpLoggerSimple* logTcp = new TcpLoggerSimple();
@@ -69,7 +91,7 @@ conga_testbed(const ArgList &args, Logfile &logfile)
         ss << "core_" << i;
         QueueLoggerSampling* qs = new QueueLoggerSampling(timeFromMs(10));
         logfile.addLogger(*qs);
-        core_switches[i] = new FairQueue(CORE_SPEED, CORE_BUFFER, qs);
+        createQueue(QueueType, core_switches[i], CORE_SPEED, CORE_BUFFER, qs);
         core_switches[i]->setName(ss.str());
         logfile.writeName(*core_switches[i]);
     }
@@ -80,7 +102,7 @@ conga_testbed(const ArgList &args, Logfile &logfile)
         ss << "leaf_" << i;
         QueueLoggerSampling* qs = new QueueLoggerSampling(timeFromMs(10));
         logfile.addLogger(*qs);
-        leaf_switches[i] = new FairQueue(LEAF_SPEED, LEAF_BUFFER, qs);
+        createQueue(QueueType, leaf_switches[i], LEAF_SPEED, LEAF_BUFFER, qs);
         leaf_switches[i]->setName(ss.str());
         logfile.writeName(*leaf_switches[i]);
     }
@@ -162,12 +184,36 @@ conga_testbed(const ArgList &args, Logfile &logfile)
     
     // Configure endhost queues
     fg->setEndhostQueue(LEAF_SPEED, ENDH_BUFFER);
+    fg->setSegmentOffload(Tso);
     // Set time limits for flow generation
     fg->setTimeLimits(0, timeFromSec(duration) - 1);
     
     EventList::Get().setEndtime(timeFromSec(duration));
 }
 
+void
+conga::createQueue(string &qType,
+                   Queue *&queue,
+                   uint64_t speed,
+                   uint64_t buffer,
+                   QueueLogger *qs)
+{
+    if (qType == "fq") {
+        queue = new FairQueue(speed, buffer, qs);
+    } else if (qType == "droptail") {
+        queue = new DropTailQueue(speed, buffer, qs);
+    } else if (qType == "red") {
+        queue = new RedQueue(speed, buffer, qs, aqmcfg);
+    } else if (qType == "codel") {
+        queue = new CodelQueue(speed, buffer, qs, aqmcfg);
+    } else if (qType == "pie") {
+        queue = new PieQueue(speed, buffer, qs, aqmcfg);
+    } else {
+        cerr << "Unknown queue type " << qType << endl;
+        exit(1);
+    }
+}
+
 // Implementation of the namespace-level route generator.
 void
 conga::generateRoute(route_t*& fwd, route_t*& rev, uint32_t& src_id, uint32_t& dst_id)
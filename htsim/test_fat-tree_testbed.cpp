@@ -5,14 +5,25 @@
 #include "logfile.h"
 #include "loggers.h"
 #include "aprx-fairqueue.h"
+#include "aqmqueue.h"
+#include "calendarqueue.h"
 #include "fairqueue.h"
+#include "hierqueue.h"
+#include "iqswitch.h"
+#include "linkevents.h"
+#include "pfc.h"
+#include "pifoqueue.h"
 #include "priorityqueue.h"
+#include "queuet.h"
 #include "stoc-fairqueue.h"
+#include "switch.h"
 #include "flow-generator.h"
 #include "pipe.h"
 #include "test.h"
 #include "prof.h"
 
+#include <unordered_map>
+
 namespace fat_tree {
     const int N_SUBTREE = 4;  // In full network
     const int N_TOR = 2;      // Per SubTree
@@ -55,8 +66,61 @@ namespace fat_tree {
     Pipe  *pServerTor[N_SUBTREE][N_TOR][N_SERVER];
     Queue *qServerTor[N_SUBTREE][N_TOR][N_SERVER];
 
+    PQcfg pqcfg; // Priority queue config.
+    CQcfg cqcfg; // Calendar queue config.
+    const std::string calq = "cq";
+    std::string pifoRank = "stfq"; // PIFO rank policy.
+    AQMcfg aqmcfg; // RED/CoDel/PIE config.
+
+    // Port types, each with its own hierarchical scheduler config.
+    enum PortType {
+        CORE_AGG,
+        AGG_CORE,
+        TOR_AGG,
+        AGG_TOR,
+        TOR_SERVER,
+        SERVER_TOR,
+        N_PORT_TYPES
+    };
+    HQcfg hqcfg[N_PORT_TYPES];
+
+    // Shared switch buffers with dynamic thresholds, 0 keeps static per-port buffers.
+    mem_b switchBuffer = 0;
+    double dtAlpha = 1;
+    std::unordered_map<Queue*, PacketSink*> switchPort; // Admission sink of each switch queue.
+
+    // Switch fabric, oq for ideal output queueing or iq for input queueing.
+    std::string fabric = "oq";
+    IQcfg iqcfg; // Input-queued switch config.
+    std::unordered_map<PacketSink*, PacketSink*> fabricInput; // Fabric input of each link into a switch.
+
+    // Priority flow control, lossless switch ports.
+    uint32_t pfc = 0;
+    PFCcfg pfccfg;
+    std::unordered_map<PacketSink*, PfcIngress*> pfcIngress; // Ingress accounting of each link into a switch.
+
+    // A link into a switch, with the queue feeding it and the link back.
+    struct Link {
+        Pipe *pipe;
+        Queue *upstream;
+        Pipe *reverse;
+    };
+
+    // Ports of one switch, its egress queues and the links into it.
+    struct SwitchPorts {
+        std::string name;
+        std::vector<Queue*> out;
+        std::vector<Link> in;
+    };
+
     void generateRandomRoute(route_t *&fwd, route_t *&rev, uint32_t &src, uint32_t &dst);
-    void createQueue(std::string &qType, Queue *&queue, uint64_t speed, uint64_t buffer, Logfile &lf);
+    void generateRoute(route_t *&fwd, route_t *&rev, uint32_t &src, uint32_t &dst);
+    bool pathUp(uint32_t src, uint32_t dst, uint32_t agg, uint32_t uplink);
+    void addHop(route_t *route, Queue *queue, Pipe *pipe);
+    std::vector<SwitchPorts> listSwitches();
+    void createSwitches(Logfile &lf);
+    void createQueue(std::string &qType, Queue *&queue, uint64_t speed, uint64_t buffer, Logfile &lf,
+                     PortType port);
 }
 
 using namespace std;
@@ -72,7 +136,6 @@ fat_tree_testbed(const ArgList &args,
     uint32_t Lstf = 0;
     string QueueType = "droptail";
     string EndHost = "dctcp";
-    string calq = "cq";
     string fairqueue = "fq";
     string FlowDist = "uniform";
 
@@ -83,28 +146,121 @@ fat_tree_testbed(const ArgList &args,
     parseString(args, "queue", QueueType);
     parseString(args, "endhost", EndHost);
     parseString(args, "flowdist", FlowDist);
+    parseInt(args, "pqLevels", pqcfg.nLevels);
+    parseInt(args, "pqWidth", pqcfg.levelWidth);
+
+    uint32_t PqAging = 0;
+    parseInt(args, "pqAging", PqAging);
+    pqcfg.agingPeriod = timeFromUs(PqAging);
+
+    uint32_t CqWidth = 1000;
+    string CqOverflow = "clamp";
+    parseInt(args, "cqSlots", cqcfg.nSlots);
+    parseInt(args, "cqWidth", CqWidth);
+    parseString(args, "cqOverflow", CqOverflow);
+    cqcfg.slotWidth = timeFromNs(CqWidth);
+    cqcfg.dropOverflow = (CqOverflow == "drop");
+
+    parseString(args, "pifoRank", pifoRank);
+    if (QueueType == "pifo" && pifoRank == SrptRank::name()) {
+        TcpSrc::_enable_pfabric = true;
+    }
+
+    uint32_t Sack = 0;
+    parseInt(args, "sack", Sack);
+    TcpSrc::_enable_sack = (Sack != 0);
+
+    uint32_t DelAck = TcpSink::_ack_every;
+    double DelAckTimeout = timeAsUs(TcpSink::_ack_delay);
+    parseInt(args, "delack", DelAck);
+    parseDouble(args, "delackTimeout", DelAckTimeout);
+    TcpSink::setDelayedAck(DelAck, timeFromUs(DelAckTimeout));
+
+    // Hierarchical scheduler, one tree for all ports unless set per port type.
+    string HqTree = hqcfg[0].tree;
+    string HqClass = "deadline";
+    parseString(args, "hqTree", HqTree);
+    parseString(args, "hqClass", HqClass);
+    if (HqClass != "deadline" && HqClass != "flow") {
+        cerr << "Unknown hq classification " << HqClass << endl;
+        exit(1);
+    }
+    // Server uplinks always run fair queueing, so only switch ports take a tree.
+    const char *hqPortArgs[SERVER_TOR] = {"hqTreeCoreAgg", "hqTreeAggCore", "hqTreeTorAgg",
+                                          "hqTreeAggTor", "hqTreeTorServer"};
+    for (int p = 0; p < SERVER_TOR; p++) {
+        hqcfg[p].tree = HqTree;
+        parseString(args, hqPortArgs[p], hqcfg[p].tree);
+        hqcfg[p].classify = (HqClass == "flow") ? HQcfg::FLOW : HQcfg::DEADLINE;
+    }
+
+    parseAqmArgs(args, aqmcfg);
+
+    parseLongInt(args, "switchBuffer", switchBuffer);
+    parseDouble(args, "dtAlpha", dtAlpha);
+
+    parseString(args, "fabric", fabric);
+    parseInt(args, "iqIterations", iqcfg.iterations);
+    parseDouble(args, "iqSpeedup", iqcfg.speedup);
+    parseLongInt(args, "iqBuffer", iqcfg.inputBuffer);
+    parseLongInt(args, "iqOutBuffer", iqcfg.outputBuffer);
+    if (fabric != "oq" && fabric != "iq") {
+        cerr << "Unknown switch fabric " << fabric << endl;
+        exit(1);
+    }
+    if (fabric == "iq" && switchBuffer > 0) {
+        cerr << "Input-queued switches do not share an egress buffer" << endl;
+        exit(1);
+    }
+
+    parseInt(args, "pfc", pfc);
+    parseInt(args, "pfcClasses", pfccfg.nClasses);
+    parseLongInt(args, "pfcXoff", pfccfg.xoff);
+    parseLongInt(args, "pfcXon", pfccfg.xon);
+    if (pfc && (fabric == "iq" || switchBuffer > 0)) {
+        cerr << "Lossless mode needs output-queued switches with static buffers" << endl;
+        exit(1);
+    }
+
+    // Link failures and changes, links named after their queues.
+    string LinkEvents;
+    string LinkEventFile;
+    parseString(args, "linkEvents", LinkEvents);
+    parseString(args, "linkEventFile", LinkEventFile);
+
+    LinkSchedule *linkSchedule = NULL;
+    if (!LinkEvents.empty() || !LinkEventFile.empty()) {
+        linkSchedule = new LinkSchedule();
+    }
+    auto addLink = [&](Queue *q, Pipe *p) {
+        if (linkSchedule) {
+            linkSchedule->addLink(q->str().substr(2), q, p);
+        }
+    };
 
     // Aggregation to core switches and vice-versa.
     for (int i = 0; i < N_SUBTREE; i++) {
         for (int j = 0; j < N_AGG; j++) {
             for (int k = 0; k < N_UPLINK; k++) {
                 // Uplink
-                createQueue(QueueType, qAggCore[i][j][k], AGG_CORE_SPEED, AGG_CORE_BUFFER, logfile);
+                createQueue(QueueType, qAggCore[i][j][k], AGG_CORE_SPEED, AGG_CORE_BUFFER, logfile, AGG_CORE);
                 qAggCore[i][j][k]->setName("q-agg-core-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(qAggCore[i][j][k]));
 
                 pAggCore[i][j][k] = new Pipe(timeFromUs(LINK_DELAY));
                 pAggCore[i][j][k]->setName("p-agg-core-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(pAggCore[i][j][k]));
+                addLink(qAggCore[i][j][k], pAggCore[i][j][k]);
 
                 // Downlink
-                createQueue(QueueType, qCoreAgg[i][j][k], AGG_CORE_SPEED, CORE_AGG_BUFFER, logfile);
+                createQueue(QueueType, qCoreAgg[i][j][k], AGG_CORE_SPEED, CORE_AGG_BUFFER, logfile, CORE_AGG);
                 qCoreAgg[i][j][k]->setName("q-core-agg-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(qCoreAgg[i][j][k]));
 
                 pCoreAgg[i][j][k] = new Pipe(timeFromUs(LINK_DELAY));
                 pCoreAgg[i][j][k]->setName("p-core-agg-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(pCoreAgg[i][j][k]));
+                addLink(qCoreAgg[i][j][k], pCoreAgg[i][j][k]);
             }
         }
     }
@@ -114,22 +270,24 @@ fat_tree_testbed(const ArgList &args,
         for (int j = 0; j < N_AGG; j++) {
             for (int k = 0; k < N_TOR; k++) {
                 // Uplink
-                createQueue(QueueType, qTorAgg[i][j][k], TOR_AGG_SPEED, TOR_AGG_BUFFER, logfile);
+                createQueue(QueueType, qTorAgg[i][j][k], TOR_AGG_SPEED, TOR_AGG_BUFFER, logfile, TOR_AGG);
                 qTorAgg[i][j][k]->setName("q-tor-agg-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(qTorAgg[i][j][k]));
 
                 pTorAgg[i][j][k] = new Pipe(timeFromUs(LINK_DELAY));
                 pTorAgg[i][j][k]->setName("p-tor-agg-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(pTorAgg[i][j][k]));
+                addLink(qTorAgg[i][j][k], pTorAgg[i][j][k]);
 
                 // Downlink
-                createQueue(QueueType, qAggTor[i][j][k], TOR_AGG_SPEED, AGG_TOR_BUFFER, logfile);
+                createQueue(QueueType, qAggTor[i][j][k], TOR_AGG_SPEED, AGG_TOR_BUFFER, logfile, AGG_TOR);
                 qAggTor[i][j][k]->setName("q-agg-tor-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(qAggTor[i][j][k]));
 
                 pAggTor[i][j][k] = new Pipe(timeFromUs(LINK_DELAY));
                 pAggTor[i][j][k]->setName("p-agg-tor-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(pAggTor[i][j][k]));
+                addLink(qAggTor[i][j][k], pAggTor[i][j][k]);
             }
         }
     }
@@ -139,26 +297,39 @@ fat_tree_testbed(const ArgList &args,
         for (int j = 0; j < N_TOR; j++) {
             for (int k = 0; k < N_SERVER; k++) {
                 // Uplink
-                createQueue(fairqueue, qServerTor[i][j][k], SERVER_TOR_SPEED, ENDH_BUFFER, logfile);
+                createQueue(fairqueue, qServerTor[i][j][k], SERVER_TOR_SPEED, ENDH_BUFFER, logfile, SERVER_TOR);
                 qServerTor[i][j][k]->setName("q-server-tor-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(qServerTor[i][j][k]));
 
                 pServerTor[i][j][k] = new Pipe(timeFromUs(LINK_DELAY));
                 pServerTor[i][j][k]->setName("p-server-tor-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(pServerTor[i][j][k]));
+                addLink(qServerTor[i][j][k], pServerTor[i][j][k]);
 
                 // Downlink
-                createQueue(QueueType, qTorServer[i][j][k], SERVER_TOR_SPEED, TOR_SERVER_BUFFER, logfile);
+                createQueue(QueueType, qTorServer[i][j][k], SERVER_TOR_SPEED, TOR_SERVER_BUFFER, logfile, TOR_SERVER);
                 qTorServer[i][j][k]->setName("q-tor-server-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(qTorServer[i][j][k]));
 
                 pTorServer[i][j][k] = new Pipe(timeFromUs(LINK_DELAY));
                 pTorServer[i][j][k]->setName("p-tor-server-" + to_string(i) + "-" + to_string(j) + "-" + to_string(k));
                 logfile.writeName(*(pTorServer[i][j][k]));
+                addLink(qTorServer[i][j][k], pTorServer[i][j][k]);
             }
         }
     }
 
+    if (switchBuffer > 0 || fabric == "iq" || pfc) {
+        createSwitches(logfile);
+    }
+
+    if (!LinkEventFile.empty()) {
+        linkSchedule->load(LinkEventFile);
+    }
+    if (!LinkEvents.empty()) {
+        linkSchedule->parse(LinkEvents);
+    }
+
     DataSource::EndHost eh = DataSource::TCP;
     DataSource::EndHost cfeh = DataSource::TCP;
     Workloads::FlowDist fd  = Workloads::UNIFORM;
@@ -206,6 +377,7 @@ fat_tree_testbed(const ArgList &args,
 
     FlowGenerator *bgFlowGen = new FlowGenerator(eh, generateRandomRoute, bg_flow_rate, AvgFlowSize, fd);
     bgFlowGen->setTimeLimits(timeFromUs(1), timeFromSec(Duration) - 1);
+    bgFlowGen->setRepathRoute(generateRoute);
 
     //CoflowGenerator *deadlineFlowGen = new CoflowGenerator(cfeh, generateRandomRoute, deadline_flow_rate);
     //deadlineFlowGen->setTimeLimits(timeFromUs(1), timeFromSec(Duration) - 1);
@@ -236,10 +408,35 @@ fat_tree::generateRandomRoute(route_t *&fwd,
         src++;
     }
 
-    uint32_t src_tree = src / N_NODES_SUBTREE;
-    uint32_t dst_tree = dst / N_NODES_SUBTREE;
+    generateRoute(fwd, rev, src, dst);
+}
+
+void
+fat_tree::generateRoute(route_t *&fwd,
+                        route_t *&rev,
+                        uint32_t &src,
+                        uint32_t &dst)
+{
     uint32_t uplink   = rand() % N_UPLINK;
     uint32_t src_agg  = rand() % N_AGG;
+
+    // Keep the random choice unless a link on it has failed.
+    if (!pathUp(src, dst, src_agg, uplink)) {
+        vector<pair<uint32_t, uint32_t> > alive;
+        for (uint32_t a = 0; a < N_AGG; a++) {
+            for (uint32_t u = 0; u < N_UPLINK; u++) {
+                if (pathUp(src, dst, a, u)) {
+                    alive.push_back(make_pair(a, u));
+                }
+            }
+        }
+        if (!alive.empty()) {
+            tie(src_agg, uplink) = alive[rand() % alive.size()];
+        }
+    }
+
+    uint32_t src_tree = src / N_NODES_SUBTREE;
+    uint32_t dst_tree = dst / N_NODES_SUBTREE;
     uint32_t dst_agg  = src_agg;
     uint32_t src_tor  = (src / N_SERVER) % N_TOR;
     uint32_t dst_tor  = (dst / N_SERVER) % N_TOR;
@@ -249,45 +446,180 @@ fat_tree::generateRandomRoute(route_t *&fwd,
     fwd = new route_t();
     rev = new route_t();
 
-    fwd->push_back(qServerTor[src_tree][src_tor][src_svr]);
-    fwd->push_back(pServerTor[src_tree][src_tor][src_svr]);
+    addHop(fwd, qServerTor[src_tree][src_tor][src_svr], pServerTor[src_tree][src_tor][src_svr]);
 
-    rev->push_back(qServerTor[dst_tree][dst_tor][dst_svr]);
-    rev->push_back(pServerTor[dst_tree][dst_tor][dst_svr]);
+    addHop(rev, qServerTor[dst_tree][dst_tor][dst_svr], pServerTor[dst_tree][dst_tor][dst_svr]);
 
     if (src_tree != dst_tree || src_tor != dst_tor) {
-        fwd->push_back(qTorAgg[src_tree][src_agg][src_tor]);
-        fwd->push_back(pTorAgg[src_tree][src_agg][src_tor]);
+        addHop(fwd, qTorAgg[src_tree][src_agg][src_tor], pTorAgg[src_tree][src_agg][src_tor]);
 
-        rev->push_back(qTorAgg[dst_tree][dst_agg][dst_tor]);
-        rev->push_back(pTorAgg[dst_tree][dst_agg][dst_tor]);
+        addHop(rev, qTorAgg[dst_tree][dst_agg][dst_tor], pTorAgg[dst_tree][dst_agg][dst_tor]);
 
         if (src_tree != dst_tree) {
-            fwd->push_back(qAggCore[src_tree][src_agg][uplink]);
-            fwd->push_back(pAggCore[src_tree][src_agg][uplink]);
+            addHop(fwd, qAggCore[src_tree][src_agg][uplink], pAggCore[src_tree][src_agg][uplink]);
 
-            rev->push_back(qAggCore[dst_tree][dst_agg][uplink]);
-            rev->push_back(pAggCore[dst_tree][dst_agg][uplink]);
+            addHop(rev, qAggCore[dst_tree][dst_agg][uplink], pAggCore[dst_tree][dst_agg][uplink]);
 
-            fwd->push_back(qCoreAgg[dst_tree][dst_agg][uplink]);
-            fwd->push_back(pCoreAgg[dst_tree][dst_agg][uplink]);
+            addHop(fwd, qCoreAgg[dst_tree][dst_agg][uplink], pCoreAgg[dst_tree][dst_agg][uplink]);
 
-            rev->push_back(qCoreAgg[src_tree][src_agg][uplink]);
-            rev->push_back(pCoreAgg[src_tree][src_agg][uplink]);
+            addHop(rev, qCoreAgg[src_tree][src_agg][uplink], pCoreAgg[src_tree][src_agg][uplink]);
         }
 
-        fwd->push_back(qAggTor[dst_tree][dst_agg][dst_tor]);
-        fwd->push_back(pAggTor[dst_tree][dst_agg][dst_tor]);
+        addHop(fwd, qAggTor[dst_tree][dst_agg][dst_tor], pAggTor[dst_tree][dst_agg][dst_tor]);
 
-        rev->push_back(qAggTor[src_tree][src_agg][src_tor]);
-        rev->push_back(pAggTor[src_tree][src_agg][src_tor]);
+        addHop(rev, qAggTor[src_tree][src_agg][src_tor], pAggTor[src_tree][src_agg][src_tor]);
     }
 
-    fwd->push_back(qTorServer[dst_tree][dst_tor][dst_svr]);
-    fwd->push_back(pTorServer[dst_tree][dst_tor][dst_svr]);
+    addHop(fwd, qTorServer[dst_tree][dst_tor][dst_svr], pTorServer[dst_tree][dst_tor][dst_svr]);
 
-    rev->push_back(qTorServer[src_tree][src_tor][src_svr]);
-    rev->push_back(pTorServer[src_tree][src_tor][src_svr]);
+    addHop(rev, qTorServer[src_tree][src_tor][src_svr], pTorServer[src_tree][src_tor][src_svr]);
+}
+
+bool
+fat_tree::pathUp(uint32_t src,
+                 uint32_t dst,
+                 uint32_t agg,
+                 uint32_t uplink)
+{
+    uint32_t src_tree = src / N_NODES_SUBTREE;
+    uint32_t dst_tree = dst / N_NODES_SUBTREE;
+    uint32_t src_tor  = (src / N_SERVER) % N_TOR;
+    uint32_t dst_tor  = (dst / N_SERVER) % N_TOR;
+
+    if (src_tree == dst_tree && src_tor == dst_tor) {
+        return true;
+    }
+
+    bool up = pTorAgg[src_tree][agg][src_tor]->isUp() && pAggTor[src_tree][agg][src_tor]->isUp()
+           && pTorAgg[dst_tree][agg][dst_tor]->isUp() && pAggTor[dst_tree][agg][dst_tor]->isUp();
+
+    if (src_tree != dst_tree) {
+        up = up && pAggCore[src_tree][agg][uplink]->isUp() && pCoreAgg[src_tree][agg][uplink]->isUp()
+                && pAggCore[dst_tree][agg][uplink]->isUp() && pCoreAgg[dst_tree][agg][uplink]->isUp();
+    }
+    return up;
+}
+
+void
+fat_tree::addHop(route_t *route, Queue *queue, Pipe *pipe)
+{
+    // Packets cross the fabric of an input-queued switch after the link into it.
+    if (!route->empty()) {
+        auto in = fabricInput.find(route->back());
+        if (in != fabricInput.end()) {
+            route->push_back(in->second);
+        }
+    }
+
+    // Lossless switches account a packet from the link in until it leaves the queue.
+    if (!route->empty()) {
+        auto in = pfcIngress.find(route->back());
+        if (in != pfcIngress.end()) {
+            route->push_back(in->second);
+            route->push_back(queue);
+            route->push_back(in->second->release());
+            route->push_back(pipe);
+            return;
+        }
+    }
+
+    // Switch queues are entered through their shared buffer admission.
+    auto it = switchPort.find(queue);
+    if (it != switchPort.end()) {
+        route->push_back(it->second);
+    }
+    route->push_back(queue);
+    route->push_back(pipe);
+}
+
+vector<fat_tree::SwitchPorts>
+fat_tree::listSwitches()
+{
+    vector<SwitchPorts> switches;
+
+    // ToR switches, server and aggregation facing ports.
+    for (int i = 0; i < N_SUBTREE; i++) {
+        for (int t = 0; t < N_TOR; t++) {
+            SwitchPorts sw;
+            sw.name = "sw-tor-" + to_string(i) + "-" + to_string(t);
+            for (int k = 0; k < N_SERVER; k++) {
+                sw.out.push_back(qTorServer[i][t][k]);
+                sw.in.push_back({pServerTor[i][t][k], qServerTor[i][t][k], pTorServer[i][t][k]});
+            }
+            for (int j = 0; j < N_AGG; j++) {
+                sw.out.push_back(qTorAgg[i][j][t]);
+                sw.in.push_back({pAggTor[i][j][t], qAggTor[i][j][t], pTorAgg[i][j][t]});
+            }
+            switches.push_back(sw);
+        }
+    }
+
+    // Aggregation switches, ToR and core facing ports.
+    for (int i = 0; i < N_SUBTREE; i++) {
+        for (int j = 0; j < N_AGG; j++) {
+            SwitchPorts sw;
+            sw.name = "sw-agg-" + to_string(i) + "-" + to_string(j);
+            for (int t = 0; t < N_TOR; t++) {
+                sw.out.push_back(qAggTor[i][j][t]);
+                sw.in.push_back({pTorAgg[i][j][t], qTorAgg[i][j][t], pAggTor[i][j][t]});
+            }
+            for (int k = 0; k < N_UPLINK; k++) {
+                sw.out.push_back(qAggCore[i][j][k]);
+                sw.in.push_back({pCoreAgg[i][j][k], qCoreAgg[i][j][k], pAggCore[i][j][k]});
+            }
+            switches.push_back(sw);
+        }
+    }
+
+    // Core switches, one port to each subtree.
+    for (int j = 0; j < N_AGG; j++) {
+        for (int k = 0; k < N_UPLINK; k++) {
+            SwitchPorts sw;
+            sw.name = "sw-core-" + to_string(j) + "-" + to_string(k);
+            for (int i = 0; i < N_SUBTREE; i++) {
+                sw.out.push_back(qCoreAgg[i][j][k]);
+                sw.in.push_back({pAggCore[i][j][k], qAggCore[i][j][k], pCoreAgg[i][j][k]});
+            }
+            switches.push_back(sw);
+        }
+    }
+
+    return switches;
+}
+
+void
+fat_tree::createSwitches(Logfile &logfile)
+{
+#if MING_PROF
+    simtime_picosec period = timeFromUs(100);
+#else
+    simtime_picosec period = timeFromMs(10);
+#endif
+
+    for (auto const &ports : listSwitches()) {
+        if (fabric == "iq") {
+            IqSwitch *sw = new IqSwitch(ports.name, iqcfg, period);
+            logfile.writeName(*sw);
+            for (auto q : ports.out) {
+                sw->addOutput(q);
+            }
+            for (auto const &link : ports.in) {
+                fabricInput[link.pipe] = sw->addInput();
+            }
+        } else if (pfc) {
+            for (auto const &link : ports.in) {
+                PfcQueue *upstream = dynamic_cast<PfcQueue*>(link.upstream);
+                assert(upstream != NULL);
+                pfcIngress[link.pipe] = new PfcIngress(link.reverse, upstream, pfccfg);
+            }
+        } else {
+            Switch *sw = new Switch(ports.name, switchBuffer, dtAlpha, period);
+            logfile.writeName(*sw);
+            for (auto q : ports.out) {
+                switchPort[q] = sw->addPort(q);
+            }
+        }
+    }
 }
 
 void
@@ -295,7 +627,8 @@ fat_tree::createQueue(string &qType,
                       Queue *&queue,
                       uint64_t speed,
                       uint64_t buffer,
-                      Logfile &logfile)
+                      Logfile &logfile,
+                      PortType port)
 {
 #if MING_PROF
     QueueLoggerSampling *qs = new QueueLoggerSampling(timeFromUs(100));
@@ -306,15 +639,48 @@ fat_tree::createQueue(string &qType,
 #endif
     logfile.addLogger(*qs);
 
+    // With a shared buffer only the dynamic threshold limits switch ports.
+    if (switchBuffer > 0 && port != SERVER_TOR) {
+        buffer = switchBuffer;
+    }
+
+    // Lossless ports are limited by ingress pauses, not by egress buffers.
+    if (pfc) {
+        if (port != SERVER_TOR) {
+            buffer = UINT64_MAX / 2;
+        }
+        queue = new PfcQueue(speed, buffer, qs, pfccfg);
+        return;
+    }
+
     if (qType == "fq") {
         queue = new FairQueue(speed, buffer, qs);
     } else if (qType == "afq") {
         queue = new AprxFairQueue(speed, buffer, qs);
+    } else if (qType == calq) {
+        queue = new CalendarQueue(speed, buffer, qs, cqcfg);
     } else if (qType == "pq") {
-        queue = new PriorityQueue(speed, buffer, qs);
+        queue = new PriorityQueue(speed, buffer, qs, pqcfg);
+    } else if (qType == "pifo") {
+        queue = newPifoQueue(pifoRank, speed, buffer, qs);
+    } else if (qType == "lstf") {
+        queue = newPifoQueue(LstfRank::name(), speed, buffer, qs);
+    } else if (qType == "red") {
+        queue = new RedQueue(speed, buffer, qs, aqmcfg);
+    } else if (qType == "codel") {
+        queue = new CodelQueue(speed, buffer, qs, aqmcfg);
+    } else if (qType == "pie") {
+        queue = new PieQueue(speed, buffer, qs, aqmcfg);
+    } else if (qType == "hq") {
+        queue = new HierQueue(speed, buffer, qs, hqcfg[port]);
     } else if (qType == "sfq") {
         queue = new StocFairQueue(speed, buffer, qs);
+    } else if (qType == "drr") {
+        queue = new StocFairQueue(speed, buffer, qs, 32, MSS_BYTES, true);
+    } else if (qType == "droptail") {
+        queue = new DropTailQueue(speed, buffer, qs);
     } else {
-        queue = new Queue(speed, buffer, qs);
+        cerr << "Unknown queue type " << qType << endl;
+        exit(1);
     }
 }
@@ -0,0 +1,169 @@
+/*
+ * Queue benchmark, wall-clock cost per packet of queue disciplines.
+ */
+#include "eventlist.h"
+#include "logfile.h"
+#include "datapacket.h"
+#include "fairqueue.h"
+#include "priorityqueue.h"
+#include "queuet.h"
+#include "test.h"
+
+#include <time.h>
+
+namespace queue_bench {
+    // Frees the packets leaving the queue.
+    class Discard : public PacketSink
+    {
+    public:
+        void receivePacket(Packet &pkt) { pkt.free(); }
+    };
+
+    // Drop-tail FIFO written out by hand, with no logging or marking. With
+    // Stats it keeps the always-on queue stats as QueueT does, and a QueueT
+    // with those policies disabled should cost the same. Without, it shows
+    // what the stats cost.
+    template<bool Stats>
+    class BareFifo : public Queue
+    {
+    public:
+        BareFifo(linkspeed_bps bitrate, mem_b maxsize)
+            : Queue(bitrate, maxsize, NULL), _currentPkt(NULL) {}
+
+        void receivePacket(Packet &pkt)
+        {
+            if (_queuesize + pkt.size() > _maxsize) {
+                if (Stats) {
+                    _stats.drop(pkt);
+                }
+                pkt.free();
+                return;
+            }
+            _packets.push_back(&pkt);
+            if (Stats) {
+                _stats.enqueue(pkt, _queuesize);
+            }
+            _queuesize += pkt.size();
+            if (_currentPkt == NULL) {
+                beginService();
+            }
+        }
+
+    protected:
+        void beginService()
+        {
+            if (!_packets.empty()) {
+                _currentPkt = _packets.front();
+                _packets.pop_front();
+                EventList::Get().sourceIsPendingRel(*this, drainTime(_currentPkt));
+            }
+        }
+
+        void completeService()
+        {
+            Packet *pkt = _currentPkt;
+            if (Stats) {
+                _stats.depart(*pkt, drainTime(pkt));
+            }
+            pkt->sendOn();
+            _queuesize -= pkt->size();
+            _currentPkt = NULL;
+            beginService();
+        }
+
+    private:
+        std::deque<Packet*> _packets;
+        Packet *_currentPkt;
+    };
+
+    // Nanoseconds per packet pushed through a queue in bursts.
+    double run(Queue *queue, uint32_t nPackets, uint32_t burst, std::vector<PacketFlow*> &flows);
+}
+
+using namespace std;
+using namespace queue_bench;
+
+void
+queue_benchmark(const ArgList &args,
+                Logfile &)
+{
+    uint32_t Packets = 1000000;
+    uint32_t Burst = 64;
+    uint32_t Flows = 16;
+    uint32_t Reps = 5;
+    parseInt(args, "packets", Packets);
+    parseInt(args, "burst", Burst);
+    parseInt(args, "flows", Flows);
+    parseInt(args, "reps", Reps);
+    if (Reps < 1) {
+        cerr << "Benchmark needs at least one repetition" << endl;
+        exit(1);
+    }
+
+    linkspeed_bps speed = 10000000000ULL;
+    mem_b buffer = 2 * Burst * MSS_BYTES;
+
+    typedef QueueT<FifoScheduler, TailDrop, NoEcn, NullLogging> NullFifo;
+    typedef QueueT<FairScheduler, PushOut, NoEcn, NullLogging> NullFair;
+
+    vector<pair<string, Queue*>> queues = {
+        {"bare-fifo-nostats", new BareFifo<false>(speed, buffer)},
+        {"bare-fifo", new BareFifo<true>(speed, buffer)},
+        {"queuet-fifo-null", new NullFifo(speed, buffer, NULL)},
+        {"queuet-fifo", new DropTailQueue(speed, buffer, NULL)},
+        {"queue", new Queue(speed, buffer, NULL)},
+        {"queuet-fq-null", new NullFair(speed, buffer, NULL)},
+        {"fq", new FairQueue(speed, buffer, NULL)},
+        {"pq", new PriorityQueue(speed, buffer, NULL)},
+    };
+
+    vector<PacketFlow*> flows;
+    for (uint32_t f = 0; f < Flows; f++) {
+        flows.push_back(new PacketFlow(NULL));
+    }
+
+    // Queues take turns each repetition so drift hits them alike. The first
+    // round warms up the packet pool and is not counted.
+    vector<double> best(queues.size(), 0);
+    for (uint32_t r = 0; r <= Reps; r++) {
+        for (uint32_t i = 0; i < queues.size(); i++) {
+            double ns = run(queues[i].second, Packets, Burst, flows);
+            if (r == 1 || (r > 1 && ns < best[i])) {
+                best[i] = ns;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < queues.size(); i++) {
+        cout << "bench " << queues[i].first << " ns/pkt " << best[i] << endl;
+    }
+
+    // Nothing left to simulate.
+    EventList::Get().setEndtime(EventList::Get().now() + 1);
+}
+
+double
+queue_bench::run(Queue *queue,
+                 uint32_t nPackets,
+                 uint32_t burst,
+                 vector<PacketFlow*> &flows)
+{
+    Discard discard;
+    route_t route = {queue, &discard};
+
+    struct timespec t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (uint32_t i = 0; i < nPackets; i += burst) {
+        for (uint32_t j = 0; j < burst; j++) {
+            DataPacket *pkt = DataPacket::newpkt(*flows[(i + j) % flows.size()], route,
+                                                 i + j, MSS_BYTES);
+            pkt->setPriority((i + j) * 2654435761U >> 20);
+            pkt->sendOn();
+        }
+        while (EventList::Get().doNextEvent()) {}
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    return ((t2.tv_sec - t1.tv_sec) * 1e9 + (t2.tv_nsec - t1.tv_nsec)) / nPackets;
+}
@@ -2,8 +2,15 @@
 #include "logfile.h"
 #include "loggers.h"
 #include "aprx-fairqueue.h"
+#include "aqmqueue.h"
+#include "calendarqueue.h"
+#include "exoqueue.h"
 #include "stoc-fairqueue.h"
 #include "fairqueue.h"
+#include "hierqueue.h"
+#include "pifoqueue.h"
+#include "priorityqueue.h"
+#include "queuet.h"
 #include "flow-generator.h"
 #include "pipe.h"
 #include "test.h"
@@ -29,10 +36,23 @@ void single_link_simulation(const ArgList &args, Logfile &logfile)
     string FlowDist = "uniform";      // Flow Distribution.
     double Utilization = 0.75;        // How loaded to run the link
     double OnOffRatio = 0.0;          // ON-OFF ration (if MaxFlows != 0).
-    string QueueType = "droptail";    // Queue type (droptail/fq/afq)
+    string QueueType = "droptail";    // Queue type (droptail/fq/afq/cq/pq/pifo/lstf/hq/sfq/drr/red/codel/pie)
     string EndHost = "tcp";           // Endhost type (tcp/pp)
     string Trace = "";                // File containing trace to replay.
     struct AFQcfg afqcfg;             // AFQ config.
+    struct PQcfg pqcfg;               // Priority queue config.
+    struct CQcfg cqcfg;               // Calendar queue config.
+    uint32_t CqWidth = 1000;          // Calendar slot width in nanosec.
+    string CqOverflow = "clamp";      // Calendar overflow handling (clamp/drop).
+    uint32_t PqAging = 0;             // Priority queue aging period in microsec.
+    string PifoRank = "stfq";         // PIFO rank policy (srpt/stfq/edf/lstf).
+    struct HQcfg hqcfg;               // Hierarchical scheduler config.
+    string HqClass = "deadline";      // Leaf classification (deadline/flow).
+    struct AQMcfg aqmcfg;             // RED/CoDel/PIE config.
+    double LossRate = 0;              // Forward link loss rate, in the good state if bursty.
+    double LossGoodBad = 0;           // Gilbert-Elliott good to bad probability, 0 for independent losses.
+    double LossBadGood = 0.5;         // Gilbert-Elliott bad to good probability.
+    double LossBad = 1;               // Loss rate in the bad state.
 
     parseInt(args, "duration", Duration);
     parseLongInt(args, "linkspeed", LinkSpeed);
@@ -51,6 +71,60 @@ void single_link_simulation(const ArgList &args, Logfile &logfile)
     parseInt(args, "afqQ", afqcfg.nQueue);
     parseInt(args, "afqBpR", afqcfg.bytesPerRound);
     parseInt(args, "afqAlpha", afqcfg.alpha);
+    parseDouble(args, "afqSample", afqcfg.sampleRate);
+    parseInt(args, "afqHeavy", afqcfg.nHeavy);
+    parseInt(args, "pqLevels", pqcfg.nLevels);
+    parseInt(args, "pqWidth", pqcfg.levelWidth);
+    parseInt(args, "pqAging", PqAging);
+    pqcfg.agingPeriod = timeFromUs(PqAging);
+    parseInt(args, "cqSlots", cqcfg.nSlots);
+    parseInt(args, "cqWidth", CqWidth);
+    parseString(args, "cqOverflow", CqOverflow);
+    cqcfg.slotWidth = timeFromNs(CqWidth);
+    cqcfg.dropOverflow = (CqOverflow == "drop");
+    parseString(args, "pifoRank", PifoRank);
+    parseString(args, "hqTree", hqcfg.tree);
+    parseString(args, "hqClass", HqClass);
+    if (HqClass == "deadline") {
+        hqcfg.classify = HQcfg::DEADLINE;
+    } else if (HqClass == "flow") {
+        hqcfg.classify = HQcfg::FLOW;
+    } else {
+        cerr << "Unknown hq classification " << HqClass << endl;
+        exit(1);
+    }
+    parseDouble(args, "lossRate", LossRate);
+    parseDouble(args, "lossGoodBad", LossGoodBad);
+    parseDouble(args, "lossBadGood", LossBadGood);
+    parseDouble(args, "lossBad", LossBad);
+
+    uint32_t Sack = 0;
+    parseInt(args, "sack", Sack);
+    TcpSrc::_enable_sack = (Sack != 0);
+
+    uint32_t DelAck = TcpSink::_ack_every;
+    double DelAckTimeout = timeAsUs(TcpSink::_ack_delay);
+    parseInt(args, "delack", DelAck);
+    parseDouble(args, "delackTimeout", DelAckTimeout);
+    TcpSink::setDelayedAck(DelAck, timeFromUs(DelAckTimeout));
+
+    uint32_t Tso = 0;
+    parseInt(args, "tso", Tso);
+
+    parseAqmArgs(args, aqmcfg);
+
+    string AfqSketch = "cu";
+    parseString(args, "afqSketch", AfqSketch);
+    if (AfqSketch == "cu") {
+        afqcfg.sketch = AFQcfg::CONSERVATIVE;
+    } else if (AfqSketch == "cm") {
+        afqcfg.sketch = AFQcfg::COUNT_MIN;
+    } else if (AfqSketch == "hh") {
+        afqcfg.sketch = AFQcfg::HEAVY_CACHE;
+    } else {
+        cerr << "Unknown afq sketch " << AfqSketch << endl;
+        exit(1);
+    }
 
     QueueLoggerSampling *qs = new QueueLoggerSampling(timeFromUs(10));
     logfile.addLogger(*qs);
@@ -72,22 +146,56 @@ void single_link_simulation(const ArgList &args, Logfile &logfile)
         queueFwd = new FairQueue(LinkSpeed, LinkBuffer, qs);
     } else if (QueueType == "afq") {
         queueFwd = new AprxFairQueue(LinkSpeed, LinkBuffer, qs, afqcfg);
+    } else if (QueueType == "cq") {
+        queueFwd = new CalendarQueue(LinkSpeed, LinkBuffer, qs, cqcfg);
+    } else if (QueueType == "pq") {
+        queueFwd = new PriorityQueue(LinkSpeed, LinkBuffer, qs, pqcfg);
+    } else if (QueueType == "pifo") {
+        queueFwd = newPifoQueue(PifoRank, LinkSpeed, LinkBuffer, qs);
+        if (PifoRank == SrptRank::name()) {
+            TcpSrc::_enable_pfabric = true;
+        }
+    } else if (QueueType == "lstf") {
+        queueFwd = newPifoQueue(LstfRank::name(), LinkSpeed, LinkBuffer, qs);
+    } else if (QueueType == "red") {
+        queueFwd = new RedQueue(LinkSpeed, LinkBuffer, qs, aqmcfg);
+    } else if (QueueType == "codel") {
+        queueFwd = new CodelQueue(LinkSpeed, LinkBuffer, qs, aqmcfg);
+    } else if (QueueType == "pie") {
+        queueFwd = new PieQueue(LinkSpeed, LinkBuffer, qs, aqmcfg);
+    } else if (QueueType == "hq") {
+        queueFwd = new HierQueue(LinkSpeed, LinkBuffer, qs, hqcfg);
     } else if (QueueType == "sfq") {
         queueFwd = new StocFairQueue(LinkSpeed, LinkBuffer, qs);
+    } else if (QueueType == "drr") {
+        queueFwd = new StocFairQueue(LinkSpeed, LinkBuffer, qs, 32, MSS_BYTES, true);
+    } else if (QueueType == "droptail") {
+        queueFwd = new DropTailQueue(LinkSpeed, LinkBuffer, qs);
     } else {
-        queueFwd = new Queue(LinkSpeed, LinkBuffer, qs);
+        cerr << "Unknown queue type " << QueueType << endl;
+        exit(1);
     }
 
     queueFwd->setName("queueFwd");
     logfile.writeName(*queueFwd);
 
-    Queue *queueRev = new Queue(LinkSpeed, LinkBuffer, NULL);
+    Queue *queueRev = new DropTailQueue(LinkSpeed, LinkBuffer, NULL);
     queueRev ->setName("queueRev");
     logfile.writeName(*queueRev);
 
     routeFwd.push_back(queueFwd);
     routeFwd.push_back(pipeFwd);
 
+    if (LossRate > 0 || LossGoodBad > 0) {
+        LossModel loss;
+        if (LossGoodBad > 0) {
+            loss.setGilbertElliott(LossGoodBad, LossBadGood, LossRate, LossBad);
+        } else {
+            loss.setRate(LossRate);
+        }
+        routeFwd.push_back(new ExoQueue(loss));
+    }
+
     routeRev.push_back(queueRev);
     routeRev.push_back(pipeRev);
 
@@ -100,6 +208,10 @@ void single_link_simulation(const ArgList &args, Logfile &logfile)
         eh = DataSource::TIMELY;
     } else if (EndHost == "dctcp") {
         eh = DataSource::DCTCP;
+    } else if (EndHost == "dtcp") {
+        eh = DataSource::D_TCP;
+    } else if (EndHost == "ddctcp") {
+        eh = DataSource::D_DCTCP;
     }
 
     if (FlowDist == "pareto") {
@@ -127,6 +239,7 @@ void single_link_simulation(const ArgList &args, Logfile &logfile)
     }
 
     flowGen->setEndhostQueue(LinkSpeed, 8192000);
+    flowGen->setSegmentOffload(Tso);
     flowGen->setTimeLimits(0, timeFromSec(Duration) - 1);
 
 
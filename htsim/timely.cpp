@@ -17,7 +17,6 @@ TimelySrc::TimelySrc(TrafficLogger *pktlogger,
       _rtt(0),
       _rto(timeFromUs(INIT_RTO_US)),
       _mdev(0),
-      _rto_timeout(0),
       _min_rtt(ULLONG_MAX),
       _prev_rtt(0),
       _rtt_diff(0.0),
@@ -50,65 +49,75 @@ TimelySrc::printStatus()
 }
 
 void
-TimelySrc::doNextEvent()
+TimelySrc::onTimer(Timer timer)
 {
     simtime_picosec current_ts = EventList::Get().now();
 
     if (TRACE_FLOW == str()) {
         cout << str() << " EV " << timeAsUs(current_ts) << " " << _state << " "
-             << timeAsUs(_rto_timeout) << " " << _flow._nPackets << endl;
+             << timer << " " << _flow._nPackets << endl;
     }
 
-    // If this is the first transmission, send a packet-pair, set rto and return.
-    if (_state == IDLE) {
-        _highest_sent = 0;
-        _last_acked = 0;
-        _bdp_estimate = 8 * MSS_BYTES;
-        _last_rtt_update = current_ts;
-        _state = NORMAL;
-    }
+    switch (timer) {
+        // First transmission, start pacing packets.
+        case START:
+            _highest_sent = 0;
+            _last_acked = 0;
+            _bdp_estimate = 8 * MSS_BYTES;
+            _last_rtt_update = current_ts;
+            _state = NORMAL;
+            // Fall through.
 
-    // Cleanup the finished flow.
-    else if (_state == FINISH) {
-        if (_flow._nPackets == 0) {
-            delete _sink;
-            delete _route_fwd;
-            delete _route_rev;
-            delete this;
-            return;
+        case PACING: {
+            sendPackets(current_ts);
+
+            /* Schedule next transmission. Time to transmit MSS_BYTES at estimated link rate. */
+            simtime_picosec nextTransmission = timeFromSec((MSS_BYTES * 8.0)/_rate);
+            setTimer(PACING, current_ts + nextTransmission);
+            break;
         }
-    }
 
-    // Retransmission timeout.
-    else if (_rto_timeout != 0 && current_ts >= _rto_timeout) {
+        // Cleanup the finished flow.
+        case TEARDOWN:
+            if (_flow._nPackets == 0) {
+                delete _sink;
+                delete _route_fwd;
+                delete _route_rev;
+                delete this;
+                return;
+            }
+            setTimer(TEARDOWN, current_ts + (_rtt != 0 ? _rtt : timeFromUs(MIN_RTO_US)));
+            break;
+
+        // Retransmission timeout.
+        case RTO:
+            cout << str() << " at " << timeAsMs(current_ts)
+                 << " RTO " << timeAsUs(_rto)
+                 << " MDEV " << timeAsUs(_mdev)
+                 << " RTT "<< timeAsUs(_rtt)
+                 << " SEQ " << _last_acked
+                 << " RTO_timeout " << timeAsMs(current_ts)
+                 << " STATE " << _state << endl;
+
+            _recover_seq = _highest_sent;
+            _highest_sent = _last_acked + MSS_BYTES;
+            _dupacks = 0;
+            _state = NORMAL;
 
-        cout << str() << " at " << timeAsMs(current_ts)
-             << " RTO " << timeAsUs(_rto)
-             << " MDEV " << timeAsUs(_mdev)
-             << " RTT "<< timeAsUs(_rtt)
-             << " SEQ " << _last_acked
-             << " RTO_timeout " << timeAsMs(_rto_timeout)
-             << " STATE " << _state << endl;
+            _rto *= 2;
+            setTimer(RTO, current_ts + _rto);
 
-        _recover_seq = _highest_sent;
-        _highest_sent = _last_acked + MSS_BYTES;
-        _dupacks = 0;
-        _state = NORMAL;
+            // Move off a failed link before retransmitting.
+            if (_flowgen != NULL) {
+                _flowgen->repath(*this);
+            }
 
-        _rto *= 2;
-        _rto_timeout = current_ts + _rto;
+            retransmitPacket(current_ts);
+            break;
 
-        retransmitPacket(current_ts);
+        default:
+            break;
     }
-
-    if (_state != FINISH) {
-        sendPackets(current_ts);
-    } 
-
-    /* Schedule next transmission. Time to transmit MSS_BYTES at estimated link rate. */
-    simtime_picosec nextTransmission = timeFromSec((MSS_BYTES * 8.0)/_rate);
-
-    EventList::Get().sourceIsPendingRel(*this, nextTransmission);
 }
 
 void
@@ -134,6 +143,9 @@ TimelySrc::receivePacket(Packet& pkt)
             _flowgen->finishFlow(id);
         }
         _state = FINISH;
+        cancelTimer(RTO);
+        cancelTimer(PACING);
+        setTimer(TEARDOWN, current_ts);
 
         cout << setprecision(6) << "Flow " << str() << "-" << id << " size " << _flowsize
              << " start " << lround(timeAsUs(_start_time)) << " end " << lround(timeAsUs(current_ts))
@@ -240,9 +252,10 @@ TimelySrc::receivePacket(Packet& pkt)
         uint64_t bytes_acked = seqno - _last_acked;
         _last_acked = seqno;
 
-        _rto_timeout = current_ts + _rto;
         if (seqno == _highest_sent) {
-            _rto_timeout = 0;
+            cancelTimer(RTO);
+        } else {
+            setTimer(RTO, current_ts + _rto);
         }
 
         // Best behavior: new ack when we were expecting it.
@@ -325,8 +338,8 @@ TimelySrc::sendPackets(simtime_picosec current_ts)
     _highest_sent += MSS_BYTES;
     _packets_sent += MSS_BYTES;
 
-    if (_rto_timeout == 0) {
-        _rto_timeout = current_ts + _rto;
+    if (!timerSet(RTO)) {
+        setTimer(RTO, current_ts + _rto);
     }
 }
 
@@ -349,8 +362,8 @@ TimelySrc::retransmitPacket(simtime_picosec current_ts)
     _packets_sent += MSS_BYTES;
     p->sendOn();
 
-    if (_rto_timeout == 0) {
-        _rto_timeout = current_ts + _rto;
+    if (!timerSet(RTO)) {
+        setTimer(RTO, current_ts + _rto);
     }
 }
 
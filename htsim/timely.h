@@ -21,7 +21,6 @@ public:
             simtime_picosec duration = 0);
 
     void printStatus();
-    void doNextEvent();
     void receivePacket(Packet &pkt);
 
     // Flow status.
@@ -43,7 +42,6 @@ public:
 
     // RTT, RTO estimates.
     simtime_picosec _rtt, _rto, _mdev;
-    simtime_picosec _rto_timeout;
     simtime_picosec _min_rtt;
     simtime_picosec _prev_rtt;
     double _rtt_diff;
@@ -54,6 +52,9 @@ public:
     uint64_t _last_rtt_bytes;
     linkspeed_bps _measured_rate;
 
+protected:
+    void onTimer(Timer timer);
+
 private:
     void sendPackets(simtime_picosec current_ts);
     void retransmitPacket(simtime_picosec current_ts);
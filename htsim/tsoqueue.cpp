@@ -0,0 +1,49 @@
+/*
+ * Endhost queue with segmentation offload
+ */
+#include "tsoqueue.h"
+#include "datapacket.h"
+
+using namespace std;
+
+const uint32_t TsoQueue::MAX_BYTES;
+
+TsoQueue::TsoQueue(linkspeed_bps bitrate,
+                   mem_b maxsize,
+                   QueueLogger *logger)
+                  : Queue(bitrate, maxsize, logger) {}
+
+void
+TsoQueue::beginService()
+{
+    assert(!_enqueued.empty());
+    mem_b wire = min(_enqueued.back()->size(), (mem_b)MSS_BYTES);
+    EventList::Get().sourceIsPendingRel(*this, (simtime_picosec)wire * _ps_per_byte);
+}
+
+void
+TsoQueue::completeService()
+{
+    assert(!_enqueued.empty());
+
+    // The last MSS leaves as the queued packet itself.
+    DataPacket *pkt = (DataPacket*)_enqueued.back();
+    if (pkt->size() <= MSS_BYTES) {
+        Queue::completeService();
+        return;
+    }
+
+    DataPacket *seg = pkt->split(MSS_BYTES);
+    _queuesize -= seg->size();
+
+    seg->flow().logTraffic(*seg, *this, TrafficLogger::PKT_DEPART);
+    _stats.departFront(*seg, drainTime(seg));
+
+    if (_logger) {
+        _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *seg);
+    }
+
+    applyEcnMark(*seg);
+    seg->sendOn();
+    beginService();
+}
@@ -0,0 +1,25 @@
+#ifndef TSO_QUEUE_H
+#define TSO_QUEUE_H
+
+/*
+ * An endhost NIC queue with segmentation offload. Sources hand it data
+ * packets of up to 64KB, held whole, and it cuts one MSS packet off the
+ * front each time it serializes, so the wire only sees MSS packets.
+ */
+
+#include "queue.h"
+
+class TsoQueue : public Queue
+{
+public:
+    // Largest segment a source may hand over.
+    static const uint32_t MAX_BYTES = 65536;
+
+    TsoQueue(linkspeed_bps bitrate, mem_b maxsize, QueueLogger *logger);
+
+protected:
+    void beginService();
+    void completeService();
+};
+
+#endif